@@ -0,0 +1,419 @@
+// CPU microbenchmarks of the hot paths of model loading and drawing, built
+// as gltf-viewer-bench. It needs no GL context, so that changes to
+// these functions can be measured on machines without GPU.
+//
+// Each benchmark runs a few warmup repetitions, then is timed repetition by
+// repetition, and the distribution of times is reported as JSON:
+//   {"build_type": ..., "repetitions": 20, "warmup": 3,
+//    "benchmarks": [{"name": "computeSceneBounds", "input": "synthetic",
+//                    "bytes": ..., "ms": {"min": ..., "median": ..., ...},
+//                    "mb_per_s": ...}, ...]}
+// Synthetic inputs are generated with a fixed seed, see generateModel().
+// Files given on the command line are benchmarked too: .gltf and .glb files
+// as models, other files as images.
+
+#include "utils/filesystem.hpp"
+#include "utils/gltf.hpp"
+#include "utils/packed_geometry.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/scene_generator.hpp"
+#include "utils/scene_graph.hpp"
+#include "utils/statistics.hpp"
+
+#include <args.hxx>
+#include <json.hpp>
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <tiny_gltf.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#ifndef GLTF_VIEWER_BUILD_TYPE
+#define GLTF_VIEWER_BUILD_TYPE "unknown"
+#endif
+
+namespace {
+
+struct Options
+{
+  uint32_t repetitions = 20;
+  uint32_t warmup = 3;
+  std::string filter; // Only run benchmarks whose name contains it
+};
+
+// Results must be consumed, otherwise the compiler could remove the
+// benchmarked code
+volatile float g_Sink = 0.f;
+
+class BenchmarkRunner
+{
+public:
+  explicit BenchmarkRunner(const Options &options) : m_Options(options) {}
+
+  // Time repetitions of run(). bytes is the size of the data processed by
+  // one repetition, 0 if it is not meaningful.
+  void run(const std::string &name, const std::string &input, size_t bytes, const std::function<void()> &run)
+  {
+    if (name.find(m_Options.filter) == std::string::npos)
+    {
+      return;
+    }
+    for (uint32_t i = 0; i < m_Options.warmup; ++i)
+    {
+      run();
+    }
+    std::vector<double> milliseconds;
+    milliseconds.reserve(m_Options.repetitions);
+    for (uint32_t i = 0; i < std::max(m_Options.repetitions, 1u); ++i)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      run();
+      milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    auto result = nlohmann::json{{"name", name}, {"input", input}, {"ms", summarize(milliseconds)}};
+    const double medianMilliseconds = result["ms"]["median"];
+    if (bytes > 0)
+    {
+      result["bytes"] = bytes;
+      result["mb_per_s"] = medianMilliseconds > 0 ? bytes / (medianMilliseconds * 1e3) : 0.;
+    }
+    std::cerr << name << " (" << input << "): " << medianMilliseconds << " ms" << std::endl;
+    m_Results.push_back(std::move(result));
+  }
+
+  const nlohmann::json &results() const { return m_Results; }
+
+private:
+  Options m_Options;
+  nlohmann::json m_Results = nlohmann::json::array();
+};
+
+// Random pixels smoothed by a gradient, so that they compress like a render
+// rather than like noise
+std::vector<unsigned char> makeSyntheticPixels(int width, int height, int channelCount)
+{
+  std::minstd_rand generator{42};
+  std::vector<unsigned char> pixels(size_t(width) * height * channelCount);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      for (int c = 0; c < channelCount; ++c)
+      {
+        pixels[(size_t(y) * width + x) * channelCount + c] = (unsigned char)((x + y * (c + 1)) / 16 % 240 + generator() % 16);
+      }
+    }
+  }
+  return pixels;
+}
+
+void appendBytes(void *context, void *data, int size)
+{
+  auto &bytes = *static_cast<std::vector<unsigned char> *>(context);
+  bytes.insert(end(bytes), static_cast<unsigned char *>(data), static_cast<unsigned char *>(data) + size);
+}
+
+// World matrices of the nodes of the default scene, indexed like model.nodes
+void computeWorldMatrices(const tinygltf::Model &model, std::vector<glm::mat4> &worldMatrices)
+{
+  worldMatrices.resize(model.nodes.size());
+  if (model.defaultScene < 0)
+  {
+    return;
+  }
+  const std::function<void(int, const glm::mat4 &)> visit = [&](int nodeIdx, const glm::mat4 &parentMatrix) {
+    const auto &node = model.nodes[nodeIdx];
+    worldMatrices[nodeIdx] = getLocalToWorldMatrix(node, parentMatrix);
+    for (const auto childIdx : node.children)
+    {
+      visit(childIdx, worldMatrices[nodeIdx]);
+    }
+  };
+  for (const auto nodeIdx : model.scenes[model.defaultScene].nodes)
+  {
+    visit(nodeIdx, glm::mat4(1));
+  }
+}
+
+void benchmarkModel(BenchmarkRunner &runner, const tinygltf::Model &model, const std::vector<BufferBytes> &buffers, const std::string &input)
+{
+  // Recursive traversal of the glTF hierarchy, the reference for the world
+  // matrices of SceneGraph, which reads local matrices with
+  // getLocalToWorldMatrix() when it is built
+  std::vector<glm::mat4> worldMatrices;
+  runner.run("getLocalToWorldMatrix", input, 0, [&]() {
+    computeWorldMatrices(model, worldMatrices);
+    g_Sink = g_Sink + (worldMatrices.empty() ? 0.f : worldMatrices.back()[3][0]);
+  });
+
+  // Moving root nodes updates world matrices of the whole scene
+  SceneGraph sceneGraph{model, model.defaultScene};
+  runner.run("updateWorldMatrices", input, 0, [&]() {
+    for (size_t nodeIdx = 0; nodeIdx < sceneGraph.nodes().size(); nodeIdx = size_t(sceneGraph.nodes()[nodeIdx].subtreeEnd))
+    {
+      sceneGraph.setTranslation(int(nodeIdx), sceneGraph.nodes()[nodeIdx].translation + glm::vec3(1e-3f));
+    }
+    sceneGraph.updateWorldMatrices();
+    g_Sink = g_Sink + (sceneGraph.nodes().empty() ? 0.f : sceneGraph.nodes().back().worldMatrix[3][0]);
+  });
+
+  size_t bufferSize = 0;
+  for (const auto &buffer : buffers)
+  {
+    bufferSize += buffer.size;
+  }
+  runner.run("computePrimitiveBounds", input, bufferSize, [&]() {
+    const auto meshPrimitiveBounds = computePrimitiveBounds(model, buffers);
+    g_Sink = g_Sink + float(meshPrimitiveBounds.size());
+  });
+
+  const auto meshPrimitiveBounds = computePrimitiveBounds(model, buffers);
+  runner.run("computeSceneBounds", input, 0, [&]() {
+    glm::vec3 bboxMin, bboxMax;
+    computeSceneBounds(sceneGraph, meshPrimitiveBounds, bboxMin, bboxMax);
+    g_Sink = g_Sink + bboxMax.x - bboxMin.x;
+  });
+
+  PackedGeometry geometry;
+  std::string err;
+  if (!packGeometry(model, buffers, geometry, err))
+  {
+    std::cerr << "Error : " << err << std::endl;
+    return;
+  }
+  runner.run("packGeometry", input, bufferSize, [&]() {
+    PackedGeometry packedGeometry;
+    packGeometry(model, buffers, packedGeometry, err);
+    g_Sink = g_Sink + float(packedGeometry.byteSize());
+  });
+
+  // Queue filled as SceneRenderer::draw() does each frame, seen from the
+  // front of the scene bounds
+  glm::vec3 bboxMin, bboxMax;
+  computeSceneBounds(sceneGraph, meshPrimitiveBounds, bboxMin, bboxMax);
+  const auto viewMatrix = glm::lookAt(glm::vec3(0.5f * (bboxMin.x + bboxMax.x), 0.5f * (bboxMin.y + bboxMax.y), bboxMax.z + 1.f),
+      0.5f * (bboxMin + bboxMax), glm::vec3(0, 1, 0));
+  const auto farPlane = 1.5f * glm::length(bboxMax - bboxMin) + 1.f;
+  RenderQueue renderQueue;
+  runner.run("RenderQueue::sort", input, 0, [&]() {
+    renderQueue.clear();
+    const auto &sceneNodes = sceneGraph.nodes();
+    for (const auto nodeIdx : sceneGraph.meshNodes())
+    {
+      const auto &node = sceneNodes[nodeIdx];
+      const auto viewDepth = -(viewMatrix * node.worldMatrix[3]).z;
+      const auto &primitives = model.meshes[node.mesh].primitives;
+      const auto &ranges = geometry.meshPrimitiveRanges[node.mesh];
+      for (size_t primIdx = 0; primIdx < primitives.size(); primIdx++)
+      {
+        renderQueue.push(RenderQueue::makeKey(0, primitives[primIdx].material, ranges[primIdx].pool + 1, viewDepth / farPlane),
+            uint32_t(nodeIdx), uint32_t(primIdx));
+      }
+    }
+    renderQueue.sort();
+    g_Sink = g_Sink + (renderQueue.items().empty() ? 0.f : float(renderQueue.items().front().node));
+  });
+}
+
+void benchmarkImageDecoding(BenchmarkRunner &runner, const std::string &name, const std::string &input, const unsigned char *bytes, size_t size)
+{
+  runner.run(name, input, size, [&]() {
+    int width = 0, height = 0, channelCount = 0;
+    const auto pixels = stbi_load_from_memory(bytes, int(size), &width, &height, &channelCount, 0);
+    g_Sink = g_Sink + (pixels ? pixels[0] : 0);
+    stbi_image_free(pixels);
+  });
+}
+
+void runSyntheticBenchmarks(BenchmarkRunner &runner)
+{
+  // Geometry only, images are benchmarked separately
+  SceneGeneratorOptions generatorOptions;
+  generatorOptions.nodeCount = 1024;
+  generatorOptions.depth = 5;
+  generatorOptions.instancesPerMesh = 16;
+  generatorOptions.trianglesPerMesh = 2048;
+  generatorOptions.materialCount = 0;
+  generatorOptions.textureCount = 0;
+  tinygltf::Model model;
+  std::string err;
+  if (!generateModel(generatorOptions, model, err))
+  {
+    std::cerr << "Error : " << err << std::endl;
+    return;
+  }
+  std::vector<BufferBytes> buffers;
+  for (const auto &buffer : model.buffers)
+  {
+    buffers.push_back({buffer.data.data(), buffer.data.size()});
+  }
+  const auto modelInput = "synthetic " + std::to_string(generatorOptions.nodeCount) + " nodes, " + std::to_string(model.meshes.size()) +
+                          " meshes of " + std::to_string(generatorOptions.trianglesPerMesh) + " triangles";
+  benchmarkModel(runner, model, buffers, modelInput);
+
+  // The model serialized in .gltf, with its buffer as a data uri
+  std::stringstream gltfStream;
+  tinygltf::TinyGLTF loader;
+  loader.WriteGltfSceneToStream(&model, gltfStream, false, false);
+  const auto gltf = gltfStream.str();
+  runner.run("parseGltf", modelInput, gltf.size(), [&]() {
+    tinygltf::Model parsedModel;
+    std::string err, warn;
+    if (!loader.LoadASCIIFromString(&parsedModel, &err, &warn, gltf.data(), (unsigned int)gltf.size(), ""))
+    {
+      std::cerr << "Error : " << err << std::endl;
+    }
+    g_Sink = g_Sink + float(parsedModel.nodes.size());
+  });
+
+  const int IMAGE_WIDTH = 2048, IMAGE_HEIGHT = 2048;
+  const auto imageInput = "synthetic " + std::to_string(IMAGE_WIDTH) + "x" + std::to_string(IMAGE_HEIGHT) + " rgb";
+  const auto pixels = makeSyntheticPixels(IMAGE_WIDTH, IMAGE_HEIGHT, 3);
+  std::vector<unsigned char> png, jpeg;
+  stbi_write_png_to_func(appendBytes, &png, IMAGE_WIDTH, IMAGE_HEIGHT, 3, pixels.data(), IMAGE_WIDTH * 3);
+  stbi_write_jpg_to_func(appendBytes, &jpeg, IMAGE_WIDTH, IMAGE_HEIGHT, 3, pixels.data(), 90);
+  benchmarkImageDecoding(runner, "decodePng", imageInput, png.data(), png.size());
+  benchmarkImageDecoding(runner, "decodeJpeg", imageInput, jpeg.data(), jpeg.size());
+}
+
+bool runFileBenchmarks(BenchmarkRunner &runner, const fs::path &path)
+{
+  const auto input = path.string();
+  auto extension = path.extension().string();
+  std::transform(begin(extension), end(extension), begin(extension), [](unsigned char c) { return char(std::tolower(c)); });
+
+  if (extension == ".gltf" || extension == ".glb")
+  {
+    tinygltf::Model model;
+    GltfBuffers buffers;
+    std::vector<EncodedImage> encodedImages;
+    std::string err, warn;
+    if (!loadGltfModel(path, model, buffers, encodedImages, err, warn))
+    {
+      std::cerr << "Error : " << err << std::endl;
+      return false;
+    }
+
+    runner.run("parseGltf", input, fs::file_size(path), [&]() {
+      tinygltf::Model parsedModel;
+      GltfBuffers parsedBuffers;
+      std::vector<EncodedImage> parsedImages;
+      std::string err, warn;
+      loadGltfModel(path, parsedModel, parsedBuffers, parsedImages, err, warn);
+      g_Sink = g_Sink + float(parsedModel.nodes.size());
+    });
+    benchmarkModel(runner, model, buffers.bytes, input);
+
+    // Images of a model are decoded concurrently by the viewer, they are
+    // decoded one after the other here to measure stb_image alone
+    size_t encodedSize = 0;
+    for (const auto &image : encodedImages)
+    {
+      encodedSize += image.bytes.size;
+    }
+    if (encodedSize > 0)
+    {
+      runner.run("decodeGltfImages", input, encodedSize, [&]() {
+        for (const auto &image : encodedImages)
+        {
+          int width = 0, height = 0, channelCount = 0;
+          const auto pixels = stbi_load_from_memory(image.bytes.data, int(image.bytes.size), &width, &height, &channelCount, 0);
+          g_Sink = g_Sink + (pixels ? pixels[0] : 0);
+          stbi_image_free(pixels);
+        }
+      });
+    }
+    return true;
+  }
+
+  std::ifstream file{input, std::ios::binary};
+  if (!file)
+  {
+    std::cerr << "Error : unable to open " << input << std::endl;
+    return false;
+  }
+  const std::vector<unsigned char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  int width = 0, height = 0, channelCount = 0;
+  if (!stbi_info_from_memory(bytes.data(), int(bytes.size()), &width, &height, &channelCount))
+  {
+    std::cerr << "Error : unable to decode " << input << ": " << stbi_failure_reason() << std::endl;
+    return false;
+  }
+  benchmarkImageDecoding(runner, "decodeImage", input, bytes.data(), bytes.size());
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  args::ArgumentParser parser{"CPU microbenchmarks of glTF Viewer. Synthetic inputs are always benchmarked."};
+  args::HelpFlag help{parser, "help", "Display this help menu", {'h', "help"}};
+  args::PositionalList<std::string> inputs{parser, "files", ".gltf or .glb models and images to benchmark"};
+  args::ValueFlag<uint32_t> repetitions{parser, "count", "Number of timed repetitions of each benchmark (default 20)", {"repetitions"}};
+  args::ValueFlag<uint32_t> warmup{parser, "count", "Number of repetitions run before timing (default 3)", {"warmup"}};
+  args::ValueFlag<std::string> filter{parser, "name", "Only run benchmarks whose name contains name", {"filter"}};
+  args::ValueFlag<std::string> output{parser, "file.json", "Write the JSON report in a file instead of stdout", {'o', "output"}};
+  try
+  {
+    parser.ParseCLI(argc, argv);
+  } catch (const args::Help &)
+  {
+    std::cout << parser;
+    return 0;
+  } catch (const args::Error &e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::cerr << parser;
+    return 1;
+  }
+
+  Options options;
+  if (repetitions)
+  {
+    options.repetitions = args::get(repetitions);
+  }
+  if (warmup)
+  {
+    options.warmup = args::get(warmup);
+  }
+  options.filter = args::get(filter);
+
+  BenchmarkRunner runner{options};
+  runSyntheticBenchmarks(runner);
+  auto returnCode = 0;
+  for (const auto &input : args::get(inputs))
+  {
+    if (!runFileBenchmarks(runner, input))
+    {
+      returnCode = 1;
+    }
+  }
+
+  const nlohmann::json report = {{"build_type", GLTF_VIEWER_BUILD_TYPE}, {"repetitions", options.repetitions},
+      {"warmup", options.warmup}, {"benchmarks", runner.results()}};
+  if (!output)
+  {
+    std::cout << report.dump(2) << std::endl;
+    return returnCode;
+  }
+  std::ofstream outputFile{args::get(output)};
+  outputFile << report.dump(2) << std::endl;
+  if (!outputFile)
+  {
+    std::cerr << "Error : unable to write " << args::get(output) << std::endl;
+    return 1;
+  }
+  return returnCode;
+}
@@ -0,0 +1,193 @@
+#include "FrameBenchmark.hpp"
+
+#include "SceneRenderer.hpp"
+#include "utils/camera_batch.hpp"
+#include "utils/statistics.hpp"
+#include "utils/tracing.hpp"
+
+#include <json.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+std::string getGLString(GLenum name)
+{
+  const auto str = glGetString(name);
+  return str ? std::string{(const char *)str} : std::string{};
+}
+
+} // namespace
+
+FrameBenchmark::FrameBenchmark(const fs::path &appPath, const Options &options) :
+    m_ShadersRootPath{appPath.parent_path() / "shaders"}, m_Options{options}
+{
+  if (m_Options.vertexShader.empty())
+  {
+    m_Options.vertexShader = m_Options.multiDrawIndirect ? "forward_indirect.vs.glsl" : "forward.vs.glsl";
+  }
+  if (m_Options.fragmentShader.empty())
+  {
+    m_Options.fragmentShader = "pbr_directional_light.fs.glsl";
+  }
+  ImGui::GetIO().IniFilename = nullptr; // No window, nothing to save
+}
+
+int FrameBenchmark::run()
+{
+  const auto &options = m_Options;
+
+  StartupProfiler profiler{fs::path{}}; // Disabled, loading is not measured
+  LoadedScene scene;
+  if (!loadScene(options.gltfFile, options.cacheDirectory, profiler, scene))
+  {
+    return -1;
+  }
+
+  std::vector<Camera> cameras;
+  if (!options.camerasPath.empty())
+  {
+    std::string err;
+    if (!loadCameraPath(options.camerasPath, cameras, err))
+    {
+      std::cerr << "Error : " << err << std::endl;
+      return -1;
+    }
+    if (cameras.empty())
+    {
+      std::cerr << "Error : no camera pose in " << options.camerasPath << std::endl;
+      return -1;
+    }
+  } else
+  {
+    // One turn around the up axis of the default camera, one pose per frame
+    const auto camera = scene.getDefaultCamera();
+    for (uint32_t i = 0; i < std::max(options.frameCount, 1u); ++i)
+    {
+      const auto angle = 2.f * glm::pi<float>() * i / std::max(options.frameCount, 1u);
+      const auto rotation = glm::rotate(glm::mat4(1), angle, camera.up());
+      const auto eye = camera.center() + glm::vec3(rotation * glm::vec4(camera.eye() - camera.center(), 0));
+      cameras.emplace_back(eye, camera.center(), camera.up());
+    }
+  }
+
+  std::unique_ptr<SceneRenderer> renderer;
+  try
+  {
+    renderer = std::make_unique<SceneRenderer>(scene, m_ShadersRootPath / options.vertexShader,
+        m_ShadersRootPath / options.fragmentShader, options.multiDrawIndirect, profiler);
+  } catch (const std::runtime_error &e)
+  {
+    std::cerr << "Error : " << e.what() << std::endl;
+    return -1;
+  }
+
+  // Frames are rendered in a framebuffer object, so that timings do not
+  // depend on the window system
+  GLuint textures[2];
+  glGenTextures(2, textures);
+  glBindTexture(GL_TEXTURE_2D, textures[0]);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, options.width, options.height);
+  glBindTexture(GL_TEXTURE_2D, textures[1]);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, options.width, options.height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  GLuint framebuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[0], 0);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[1], 0);
+
+  // GPU times are read a few frames late, so that waiting for them does not
+  // drain the GPU queue
+  const size_t QUERY_COUNT = 4;
+  GLuint queries[QUERY_COUNT];
+  glGenQueries(QUERY_COUNT, queries);
+
+  const auto frameCount = options.frameCount;
+  const auto totalFrameCount = options.warmupFrameCount + frameCount;
+  std::vector<double> cpuMilliseconds, gpuMilliseconds, frameMilliseconds;
+  std::vector<uint32_t> drawCalls, stateChanges;
+  std::vector<uint64_t> triangles;
+  const auto readGpuTime = [&](uint32_t frameIdx) {
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(queries[frameIdx % QUERY_COUNT], GL_QUERY_RESULT, &nanoseconds);
+    if (frameIdx >= options.warmupFrameCount)
+    {
+      gpuMilliseconds.push_back(nanoseconds * 1e-6);
+    }
+  };
+
+  const auto projMatrix = renderer->getProjectionMatrix(float(options.width) / options.height);
+  const SceneRenderer::Lighting lighting;
+  auto previousFrameStart = std::chrono::steady_clock::now();
+  for (uint32_t frameIdx = 0; frameIdx < totalFrameCount; ++frameIdx)
+  {
+    TRACE_ZONE("frame");
+    if (frameIdx >= QUERY_COUNT)
+    {
+      readGpuTime(frameIdx - QUERY_COUNT);
+    }
+
+    const auto frameStart = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, queries[frameIdx % QUERY_COUNT]);
+    renderer->draw(cameras[frameIdx % cameras.size()], projMatrix, options.width, options.height, lighting);
+    glEndQuery(GL_TIME_ELAPSED);
+    glFlush();
+    const auto submitEnd = std::chrono::steady_clock::now();
+
+    if (frameIdx > options.warmupFrameCount)
+    {
+      frameMilliseconds.push_back(std::chrono::duration<double, std::milli>(frameStart - previousFrameStart).count());
+    }
+    previousFrameStart = frameStart;
+    if (frameIdx >= options.warmupFrameCount)
+    {
+      cpuMilliseconds.push_back(std::chrono::duration<double, std::milli>(submitEnd - frameStart).count());
+      const auto &stats = renderer->lastDrawStats();
+      drawCalls.push_back(stats.drawCalls);
+      triangles.push_back(stats.triangles);
+      stateChanges.push_back(stats.stateChanges);
+    }
+  }
+  for (auto frameIdx = totalFrameCount > QUERY_COUNT ? totalFrameCount - uint32_t(QUERY_COUNT) : 0; frameIdx < totalFrameCount;
+       ++frameIdx)
+  {
+    readGpuTime(frameIdx);
+  }
+
+  glDeleteQueries(QUERY_COUNT, queries);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteTextures(2, textures);
+  renderer.reset();
+
+  const nlohmann::json report = {{"model", options.gltfFile.string()},
+      {"camera_path", options.camerasPath.empty() ? std::string{"orbit"} : options.camerasPath.string()}, {"width", options.width},
+      {"height", options.height}, {"frames", frameCount}, {"warmup_frames", options.warmupFrameCount},
+      {"vertex_shader", options.vertexShader}, {"fragment_shader", options.fragmentShader},
+      {"multi_draw_indirect", options.multiDrawIndirect}, {"gl_renderer", getGLString(GL_RENDERER)},
+      {"gl_version", getGLString(GL_VERSION)}, {"cpu_ms", summarize(cpuMilliseconds)}, {"gpu_ms", summarize(gpuMilliseconds)},
+      {"frame_ms", summarize(frameMilliseconds)}, {"draw_calls", summarize(drawCalls)}, {"triangles", summarize(triangles)},
+      {"state_changes", summarize(stateChanges)}};
+
+  if (options.outputPath.empty())
+  {
+    std::cout << report.dump(2) << std::endl;
+    return 0;
+  }
+  std::ofstream output{options.outputPath.string()};
+  output << report.dump(2) << std::endl;
+  if (!output)
+  {
+    std::cerr << "Error : unable to write " << options.outputPath << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "utils/GLFWHandle.hpp"
+#include "utils/filesystem.hpp"
+
+#include <cstdint>
+#include <string>
+
+// Render a model offscreen for a fixed number of frames along a
+// deterministic camera path, without vsync, and report the distribution of
+// CPU, GPU and wall frame times and of the work submitted per frame as JSON:
+//   {"model": ..., "frames": 300, ...,
+//    "cpu_ms": {"min": ..., "median": ..., "p95": ..., "p99": ..., ...},
+//    "gpu_ms": {...}, "frame_ms": {...}, "draw_calls": {...},
+//    "triangles": {...}, "state_changes": {...}}
+// cpu_ms is the time spent submitting a frame, gpu_ms the time the GPU spent
+// on it (GL_TIME_ELAPSED) and frame_ms the time between starts of
+// consecutive frames.
+class FrameBenchmark
+{
+public:
+  struct Options
+  {
+    fs::path gltfFile;
+    fs::path camerasPath; // Camera path file, see loadCameraPath(). Orbit around the scene if empty.
+    fs::path outputPath;  // JSON report, written on stdout if empty
+    fs::path cacheDirectory;
+    std::string vertexShader;
+    std::string fragmentShader;
+    int32_t width = 1280;
+    int32_t height = 720;
+    uint32_t frameCount = 300;
+    uint32_t warmupFrameCount = 10; // Rendered before measuring
+    bool multiDrawIndirect = false;
+  };
+
+  FrameBenchmark(const fs::path &appPath, const Options &options);
+
+  int run();
+
+private:
+  const fs::path m_ShadersRootPath;
+  Options m_Options;
+
+  // Last to be initialized, first to be destroyed
+  GLFWHandle m_GLFWHandle{1, 1, "glTF Viewer", false};
+};
@@ -0,0 +1,395 @@
+#include "RenderServer.hpp"
+
+#include "utils/image_writer.hpp"
+#include "utils/tracing.hpp"
+
+#include <json.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+nlohmann::json makeError(const nlohmann::json &id, const std::string &error)
+{
+  nlohmann::json response = {{"ok", false}, {"error", error}};
+  if (!id.is_null())
+  {
+    response["id"] = id;
+  }
+  return response;
+}
+
+#ifndef _WIN32
+bool writeAll(int fd, const std::string &data)
+{
+#ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL; // A closed client must not kill the server
+#else
+  const int flags = 0;
+#endif
+  for (size_t written = 0; written < data.size();)
+  {
+    const auto count = ::send(fd, data.data() + written, data.size() - written, flags);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    written += size_t(count);
+  }
+  return true;
+}
+#endif
+
+} // namespace
+
+RenderServer::RenderServer(const fs::path &appPath, const fs::path &cacheDirectory, uint64_t cacheBudget, bool releaseCpuData) :
+    m_GLFWHandle{1, 1, "glTF Viewer", false},
+    m_ShadersRootPath{appPath.parent_path() / "shaders"},
+    m_CacheDirectory{cacheDirectory},
+    m_nCacheBudget{cacheBudget},
+    m_bReleaseCpuData{releaseCpuData}
+{
+  ImGui::GetIO().IniFilename = nullptr; // No window, nothing to save
+  printGLVersion();
+}
+
+int RenderServer::serveStdin()
+{
+  std::string line;
+  while (std::getline(std::cin, line))
+  {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+    {
+      continue;
+    }
+    std::cout << handleRequest(line) << std::endl;
+  }
+  return 0;
+}
+
+int RenderServer::serveSocket(const fs::path &socketPath)
+{
+#ifdef _WIN32
+  std::cerr << "Error : Unix domain sockets are not supported on this platform" << std::endl;
+  return -1;
+#else
+  const auto strPath = socketPath.string();
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (strPath.size() >= sizeof(address.sun_path))
+  {
+    std::cerr << "Error : socket path too long: " << strPath << std::endl;
+    return -1;
+  }
+  std::strcpy(address.sun_path, strPath.c_str());
+
+  const auto listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(strPath.c_str()); // Left by a previous server
+  if (listener < 0 || ::bind(listener, (const sockaddr *)&address, sizeof(address)) < 0 || ::listen(listener, 16) < 0)
+  {
+    std::cerr << "Error : unable to listen on " << strPath << ": " << std::strerror(errno) << std::endl;
+    if (listener >= 0)
+    {
+      ::close(listener);
+    }
+    return -1;
+  }
+  std::clog << "Listening on " << strPath << std::endl;
+
+  // Requests of all clients are answered in order of arrival, one at a time
+  struct Client
+  {
+    int fd;
+    std::string input; // Received bytes following the last complete line
+  };
+  std::vector<Client> clients;
+  std::vector<pollfd> pollFds;
+  for (;;)
+  {
+    pollFds.clear();
+    pollFds.push_back({listener, POLLIN, 0});
+    for (const auto &client : clients)
+    {
+      pollFds.push_back({client.fd, POLLIN, 0});
+    }
+
+    if (::poll(pollFds.data(), pollFds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      std::cerr << "Error : poll failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    // Backward, so that removing a client does not shift those left to visit
+    for (auto i = pollFds.size() - 1; i > 0; --i)
+    {
+      if (!pollFds[i].revents)
+      {
+        continue;
+      }
+
+      auto &client = clients[i - 1];
+      char buffer[4096];
+      const auto count = ::read(client.fd, buffer, sizeof(buffer));
+      auto connected = count > 0;
+      if (connected)
+      {
+        client.input.append(buffer, size_t(count));
+        for (auto eol = client.input.find('\n'); connected && eol != std::string::npos; eol = client.input.find('\n'))
+        {
+          const auto line = client.input.substr(0, eol);
+          client.input.erase(0, eol + 1);
+          if (line.find_first_not_of(" \t\r") != std::string::npos)
+          {
+            connected = writeAll(client.fd, handleRequest(line) + "\n");
+          }
+        }
+      }
+
+      if (!connected)
+      {
+        ::close(client.fd);
+        clients.erase(begin(clients) + (i - 1));
+      }
+    }
+
+    if (pollFds[0].revents & POLLIN)
+    {
+      const auto fd = ::accept(listener, nullptr, nullptr);
+      if (fd >= 0)
+      {
+        clients.push_back({fd, {}});
+      }
+    }
+  }
+
+  for (const auto &client : clients)
+  {
+    ::close(client.fd);
+  }
+  ::close(listener);
+  ::unlink(strPath.c_str());
+  return -1;
+#endif
+}
+
+std::string RenderServer::handleRequest(const std::string &line)
+{
+  TRACE_ZONE("handleRequest");
+  const auto startTime = std::chrono::steady_clock::now();
+
+  const auto request = nlohmann::json::parse(line, nullptr, false);
+  if (!request.is_object())
+  {
+    return makeError(nullptr, "request is not a JSON object").dump();
+  }
+  const auto id = request.count("id") ? request["id"] : nlohmann::json{};
+
+  const auto getString = [&](const char *key, const std::string &defaultValue) {
+    const auto it = request.find(key);
+    return it != end(request) && it->is_string() ? it->get<std::string>() : defaultValue;
+  };
+  const auto getInt = [&](const char *key, int defaultValue) {
+    const auto it = request.find(key);
+    return it != end(request) && it->is_number_integer() ? it->get<int>() : defaultValue;
+  };
+
+  const auto model = getString("model", "");
+  const auto output = getString("output", "");
+  if (model.empty() || output.empty())
+  {
+    return makeError(id, "\"model\" and \"output\" are required").dump();
+  }
+
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  const auto width = getInt("width", 1280);
+  const auto height = getInt("height", 720);
+  if (width <= 0 || height <= 0 || width > maxSize || height > maxSize)
+  {
+    return makeError(id, "invalid size, maximum is " + std::to_string(maxSize)).dump();
+  }
+
+  // The format is the one of the output extension unless it is given
+  ImageWriterOptions writerOptions;
+  ImageFormat pathFormat;
+  const auto hasPathFormat = getImageFormat(output, pathFormat);
+  const auto formatName = getString("format", "");
+  if (!formatName.empty())
+  {
+    if (!parseImageFormat(formatName, writerOptions.format))
+    {
+      return makeError(id, "unknown format " + formatName).dump();
+    }
+    if (hasPathFormat && pathFormat != writerOptions.format)
+    {
+      return makeError(id, "format " + formatName + " does not match the extension of \"output\"").dump();
+    }
+  } else if (hasPathFormat)
+  {
+    writerOptions.format = pathFormat;
+  }
+
+  const auto it = request.find("lookat");
+  std::vector<float> lookat;
+  if (it != end(request))
+  {
+    if (!it->is_array() || it->size() != 9)
+    {
+      return makeError(id, "\"lookat\" must be an array of 9 numbers").dump();
+    }
+    for (const auto &value : *it)
+    {
+      if (!value.is_number())
+      {
+        return makeError(id, "\"lookat\" must be an array of 9 numbers").dump();
+      }
+      lookat.push_back(value.get<float>());
+    }
+  }
+
+  bool cached = false;
+  const LoadedScene *scene = nullptr;
+  SceneRenderer *renderer = nullptr;
+  try
+  {
+    auto &cachedModel = getModel(model);
+    renderer = &getRenderer(cachedModel, getString("vs", "forward.vs.glsl"), getString("fs", "pbr_directional_light.fs.glsl"), cached);
+    scene = cachedModel.scene.get();
+  } catch (const std::exception &e)
+  {
+    return makeError(id, e.what()).dump();
+  }
+
+  const auto camera = lookat.empty() ? scene->getDefaultCamera()
+                                     : Camera{glm::vec3(lookat[0], lookat[1], lookat[2]), glm::vec3(lookat[3], lookat[4], lookat[5]),
+                                           glm::vec3(lookat[6], lookat[7], lookat[8])};
+
+  const auto pixelType = GLenum(isFloatImageFormat(writerOptions.format) ? GL_FLOAT : GL_UNSIGNED_BYTE);
+  if (!m_pReadback || m_nReadbackWidth != width || m_nReadbackHeight != height || m_ReadbackPixelType != pixelType)
+  {
+    m_pReadback.reset();
+    m_pReadback = std::make_unique<FrameReadback>(
+        width, height, pixelType, 1, [this](size_t, std::vector<unsigned char> &&pixels) { m_Pixels = std::move(pixels); });
+    m_nReadbackWidth = width;
+    m_nReadbackHeight = height;
+    m_ReadbackPixelType = pixelType;
+  }
+
+  // Read back bottom row first, see ViewerApplication::renderScene()
+  const auto projMatrix = glm::scale(glm::mat4(1), glm::vec3(1, -1, 1)) * renderer->getProjectionMatrix(float(width) / height);
+  m_pReadback->render([&]() { renderer->draw(camera, projMatrix, width, height, SceneRenderer::Lighting{}); });
+  m_pReadback->flush();
+
+  std::string err;
+  if (m_Pixels.empty())
+  {
+    return makeError(id, "unable to read back the render").dump();
+  }
+  if (!writeImage(output, width, height, m_Pixels.data(), writerOptions, err))
+  {
+    return makeError(id, err).dump();
+  }
+
+  const auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+  nlohmann::json response = {{"ok", true}, {"output", output}, {"cached", cached}, {"ms", milliseconds}};
+  if (!id.is_null())
+  {
+    response["id"] = id;
+  }
+  return response.dump();
+}
+
+RenderServer::CachedModel &RenderServer::getModel(const fs::path &gltfFile)
+{
+  std::error_code error;
+  const auto fileSize = uint64_t(fs::file_size(gltfFile, error));
+  const auto modificationTime = error ? 0 : int64_t(fs::last_write_time(gltfFile, error).time_since_epoch().count());
+  if (error)
+  {
+    throw std::runtime_error("unable to load " + gltfFile.string() + ": " + error.message());
+  }
+
+  const auto key = gltfFile.string();
+  const auto it = m_ModelIndex.find(key);
+  if (it != end(m_ModelIndex))
+  {
+    const auto modelIt = it->second;
+    if (modelIt->fileSize == fileSize && modelIt->modificationTime == modificationTime)
+    {
+      m_Models.splice(begin(m_Models), m_Models, modelIt);
+      return m_Models.front();
+    }
+    // The file changed since it has been loaded
+    m_nCachedBytes -= modelIt->byteSize;
+    m_ModelIndex.erase(it);
+    m_Models.erase(modelIt);
+  }
+
+  auto scene = std::make_unique<LoadedScene>();
+  if (!loadScene(gltfFile, m_CacheDirectory, m_Profiler, *scene))
+  {
+    throw std::runtime_error("unable to load " + gltfFile.string());
+  }
+  auto resources = std::make_unique<SceneResources>(*scene, m_Profiler);
+  if (m_bReleaseCpuData)
+  {
+    scene->releaseUploadedData();
+  }
+  const auto byteSize = scene->byteSize() + resources->byteSize();
+
+  m_Models.push_front({key, fileSize, modificationTime, std::move(scene), std::move(resources), {}, byteSize});
+  m_ModelIndex[key] = begin(m_Models);
+  m_nCachedBytes += byteSize;
+  evictScenes();
+  return m_Models.front();
+}
+
+SceneRenderer &RenderServer::getRenderer(
+    CachedModel &model, const std::string &vertexShader, const std::string &fragmentShader, bool &cached)
+{
+  const auto key = vertexShader + "\n" + fragmentShader;
+  const auto it = model.renderers.find(key);
+  cached = it != end(model.renderers);
+  if (cached)
+  {
+    return *it->second;
+  }
+
+  auto renderer = std::make_unique<SceneRenderer>(
+      *model.resources, m_ShadersRootPath / vertexShader, m_ShadersRootPath / fragmentShader, false, m_Profiler);
+  auto &result = *renderer;
+  model.renderers.emplace(key, std::move(renderer));
+  return result;
+}
+
+void RenderServer::evictScenes()
+{
+  while (m_nCachedBytes > m_nCacheBudget && m_Models.size() > 1)
+  {
+    auto &model = m_Models.back();
+    m_nCachedBytes -= model.byteSize;
+    m_ModelIndex.erase(model.key);
+    m_Models.pop_back();
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "SceneRenderer.hpp"
+#include "utils/GLFWHandle.hpp"
+#include "utils/filesystem.hpp"
+#include "utils/frame_readback.hpp"
+#include "utils/startup_profiler.hpp"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Render requests received as lines of JSON, each answered by a line of JSON:
+//   {"model": "scene.gltf", "output": "out.png", "lookat": [eye_x, ..., up_z],
+//    "width": 1280, "height": 720, "vs": "forward.vs.glsl",
+//    "fs": "pbr_directional_light.fs.glsl", "format": "png", "id": ...}
+// Only model and output are required. The camera defaults to the one of the
+// viewer, the format to the extension of output. id is sent back in the
+// response:
+//   {"id": ..., "ok": true, "output": "out.png", "cached": true, "ms": 12.5}
+//   {"id": ..., "ok": false, "error": "..."}
+// Loaded scenes and their GPU objects are kept in a LRU cache bounded in
+// bytes, so that renders of recently used models only cost drawing and
+// encoding.
+class RenderServer
+{
+public:
+  // If releaseCpuData, CPU copies of images and buffers of cached scenes are
+  // freed once uploaded, see LoadedScene::releaseUploadedData()
+  RenderServer(const fs::path &appPath, const fs::path &cacheDirectory, uint64_t cacheBudget, bool releaseCpuData);
+
+  // Answer requests read from stdin on stdout, until stdin is closed
+  int serveStdin();
+
+  // Answer requests of the clients of a Unix domain socket created at
+  // socketPath. Only returns on error.
+  int serveSocket(const fs::path &socketPath);
+
+  // Render the request of a line and return the response line
+  std::string handleRequest(const std::string &line);
+
+private:
+  // Scenes are loaded and uploaded once per file. Their GPU objects are
+  // shared by the renderers of all the shader pairs the file is drawn with,
+  // which only own their program.
+  struct CachedModel
+  {
+    std::string key; // Path of the file
+    uint64_t fileSize;
+    int64_t modificationTime;
+    std::unique_ptr<LoadedScene> scene;
+    // Members are declared after what they reference
+    std::unique_ptr<SceneResources> resources;
+    std::unordered_map<std::string, std::unique_ptr<SceneRenderer>> renderers; // Keyed by shader pair
+    uint64_t byteSize;
+  };
+
+  // Return the cached model of a file, loading and uploading it if it is not
+  // cached or if its size or modification time changed. Throw
+  // std::runtime_error if it cannot be loaded.
+  CachedModel &getModel(const fs::path &gltfFile);
+
+  // Return the renderer of a cached model for the given shaders, compiling
+  // its program if needed
+  SceneRenderer &getRenderer(CachedModel &model, const std::string &vertexShader, const std::string &fragmentShader, bool &cached);
+
+  // Release least recently used models until the cache fits its budget. The
+  // most recently used model is always kept.
+  void evictScenes();
+
+  // Declared first, so that the context is destroyed after all GL objects
+  GLFWHandle m_GLFWHandle;
+
+  const fs::path m_ShadersRootPath;
+  const fs::path m_CacheDirectory;
+  const uint64_t m_nCacheBudget;
+  const bool m_bReleaseCpuData;
+  StartupProfiler m_Profiler{fs::path{}}; // Disabled, loading is not profiled
+
+  std::list<CachedModel> m_Models; // Most recently used first
+  std::unordered_map<std::string, std::list<CachedModel>::iterator> m_ModelIndex;
+  uint64_t m_nCachedBytes = 0;
+
+  // Recreated when the size or pixel type of requests changes
+  std::unique_ptr<FrameReadback> m_pReadback;
+  GLsizei m_nReadbackWidth = 0;
+  GLsizei m_nReadbackHeight = 0;
+  GLenum m_ReadbackPixelType = GL_UNSIGNED_BYTE;
+  std::vector<unsigned char> m_Pixels;
+};
@@ -0,0 +1,808 @@
+#include "SceneRenderer.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "utils/thread_pool.hpp"
+#include "utils/tracing.hpp"
+
+namespace {
+
+const GLuint MATERIAL_BLOCK_BINDING = 0;
+// Set by the layout of the DrawTransforms block in forward_indirect.vs.glsl
+const GLuint DRAW_TRANSFORMS_BINDING = 0;
+
+// Sampler uniforms never change: each material texture has its own unit
+const GLint BASE_COLOR_TEXTURE_UNIT = 0;
+const GLint METALLIC_ROUGHNESS_TEXTURE_UNIT = 1;
+const GLint EMISSIVE_TEXTURE_UNIT = 2;
+const GLint OCCLUSION_TEXTURE_UNIT = 3;
+
+} // namespace
+
+// Number of triangles drawn from count vertices
+static uint64_t countTriangles(int mode, uint64_t count)
+{
+  switch (mode)
+  {
+  case GL_TRIANGLES:
+    return count / 3;
+  case GL_TRIANGLE_STRIP:
+  case GL_TRIANGLE_FAN:
+    return count >= 3 ? count - 2 : 0;
+  default:
+    return 0;
+  }
+}
+
+static uint64_t getTotalSize(const std::vector<BufferBytes> &buffers)
+{
+  return std::accumulate(
+      begin(buffers), end(buffers), uint64_t(0), [](uint64_t size, const BufferBytes &bytes) { return size + bytes.size; });
+}
+
+static bool loadGltfFile(const fs::path &gltfFile, StartupProfiler &profiler, tinygltf::Model &model, GltfBuffers &buffers)
+{
+  TRACE_ZONE("loadGltfFile");
+  std::string warn;
+  std::string err;
+  std::vector<EncodedImage> encodedImages;
+  bool ret;
+  {
+    ScopedStartupPhase phase{profiler, "parse_gltf"};
+    ret = loadGltfModel(gltfFile, model, buffers, encodedImages, err, warn);
+    phase.bytes = getTotalSize(buffers.bytes);
+  }
+
+  if (ret)
+  {
+    ScopedStartupPhase phase{profiler, "decode_images"};
+    ThreadPool pool;
+    ret = decodeGltfImages(model, encodedImages, pool, err);
+    for (const auto &encodedImage : encodedImages)
+    {
+      phase.bytes += encodedImage.bytes.size;
+    }
+  }
+
+  if (!warn.empty())
+  {
+    std::cerr << "Warn : " << warn << std::endl;
+  }
+
+  if (!err.empty())
+  {
+    std::cerr << "Error : " << err << std::endl;
+  }
+
+  if (!ret)
+  {
+    std::cerr << "Failed to parse the glTF file" << std::endl;
+  }
+
+  return ret;
+}
+
+Camera LoadedScene::getDefaultCamera() const
+{
+  const auto up = glm::vec3(0, 1, 0);
+  const auto center = (bboxMin + bboxMax) * 0.5f;
+  const auto diag = bboxMax - bboxMin;
+  return Camera{diag, center, up};
+}
+
+uint64_t LoadedScene::byteSize() const
+{
+  uint64_t size = getTotalSize(buffers.bytes);
+  for (const auto &image : model.images)
+  {
+    size += image.image.size();
+  }
+  size += getTotalSize(sceneCache.imagePixels);
+  return size + packedGeometry.byteSize();
+}
+
+void LoadedScene::releaseUploadedData()
+{
+  TRACE_ZONE("releaseUploadedData");
+  // Vectors are swapped with empty ones, clear() would keep their capacity
+  for (auto &image : model.images)
+  {
+    std::vector<unsigned char>{}.swap(image.image);
+  }
+  for (auto &buffer : model.buffers)
+  {
+    std::vector<unsigned char>{}.swap(buffer.data);
+  }
+  std::vector<tinygltf::Animation>{}.swap(model.animations);
+  // Image pixels of the scene cache point into a mapping of buffers
+  std::vector<BufferBytes>{}.swap(sceneCache.imagePixels);
+  buffers = GltfBuffers{};
+
+  // Pools layout and primitive ranges are kept, they are read by draw
+  // commands
+  packedGeometry.releaseBytes();
+}
+
+bool loadScene(
+    const fs::path &gltfFile, const fs::path &cacheDirectory, StartupProfiler &profiler, LoadedScene &scene)
+{
+  TRACE_ZONE("loadScene");
+  auto &model = scene.model;
+  auto &modelBuffers = scene.buffers;
+  auto &sceneCache = scene.sceneCache;
+
+  fs::path sceneCachePath;
+  auto sceneCacheLoaded = false;
+  if (!cacheDirectory.empty())
+  {
+    ScopedStartupPhase phase{profiler, "load_scene_cache"};
+    sceneCachePath = getSceneCachePath(cacheDirectory, gltfFile);
+    sceneCacheLoaded = !sceneCachePath.empty() &&
+                       loadSceneCache(sceneCachePath, model, modelBuffers, sceneCache, scene.sceneGraph, scene.packedGeometry,
+                           scene.meshPrimitiveBounds);
+    phase.bytes = sceneCacheLoaded ? modelBuffers.mappedFiles[0].size() : 0;
+  }
+
+  if (sceneCacheLoaded)
+  {
+    ScopedStartupPhase phase{profiler, "compute_scene_bounds"};
+    computeSceneBounds(scene.sceneGraph, scene.meshPrimitiveBounds, scene.bboxMin, scene.bboxMax);
+    return true;
+  }
+
+  if (!loadGltfFile(gltfFile, profiler, model, modelBuffers))
+  {
+    return false;
+  }
+
+  profiler.beginPhase("build_scene_graph");
+  scene.sceneGraph = SceneGraph{model, model.defaultScene};
+  profiler.endPhase();
+
+  profiler.beginPhase("compute_scene_bounds");
+  scene.meshPrimitiveBounds = computePrimitiveBounds(model, modelBuffers.bytes);
+  computeSceneBounds(scene.sceneGraph, scene.meshPrimitiveBounds, scene.bboxMin, scene.bboxMax);
+  profiler.endPhase();
+
+  {
+    ScopedStartupPhase phase{profiler, "pack_geometry"};
+    std::string err;
+    if (!packGeometry(model, modelBuffers.bytes, scene.packedGeometry, err))
+    {
+      std::cerr << "Error : " << err << std::endl;
+      return false;
+    }
+    phase.bytes = getTotalSize(modelBuffers.bytes);
+  }
+
+  if (!sceneCachePath.empty())
+  {
+    ScopedStartupPhase phase{profiler, "write_scene_cache"};
+    std::string err;
+    if (!writeSceneCache(sceneCachePath, gltfFile, model, scene.sceneGraph, scene.packedGeometry, scene.meshPrimitiveBounds, err))
+    {
+      std::cerr << "Warn : unable to write scene cache: " << err << std::endl;
+    }
+  }
+
+  return true;
+}
+
+GLuint SceneResources::createMaterialBufferObject(const tinygltf::Model &model, GLsizeiptr &blockStride) const
+{
+  TRACE_ZONE("createMaterialBufferObject");
+  // Each block must start at a multiple of the offset alignment to be bound
+  // with glBindBufferRange
+  GLint offsetAlignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+  blockStride = GLsizeiptr(sizeof(MaterialBlock));
+  if (offsetAlignment > 0)
+  {
+    blockStride = (blockStride + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+  }
+
+  // First block is the default material, used by primitives without material
+  std::vector<unsigned char> data((model.materials.size() + 1) * blockStride, 0);
+  const auto writeBlock = [&](size_t blockIdx, const MaterialBlock &block) {
+    std::memcpy(data.data() + blockIdx * blockStride, &block, sizeof(block));
+  };
+  writeBlock(0, {{1, 1, 1, 1}, {0, 0, 0}, 1.f, 1.f, 0.f, {}});
+  for (size_t i = 0; i < model.materials.size(); i++)
+  {
+    const auto &material = model.materials[i];
+    const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+    const auto &baseColorFactor = pbrMetallicRoughness.baseColorFactor;
+    const auto &emissiveFactor = material.emissiveFactor;
+    writeBlock(i + 1, {{float(baseColorFactor[0]), float(baseColorFactor[1]), float(baseColorFactor[2]), float(baseColorFactor[3])},
+                          {float(emissiveFactor[0]), float(emissiveFactor[1]), float(emissiveFactor[2])},
+                          float(pbrMetallicRoughness.metallicFactor), float(pbrMetallicRoughness.roughnessFactor),
+                          float(material.occlusionTexture.strength), {}});
+  }
+
+  GLuint bufferObject = 0;
+  glGenBuffers(1, &bufferObject);
+  glBindBuffer(GL_UNIFORM_BUFFER, bufferObject);
+  glBufferStorage(GL_UNIFORM_BUFFER, GLsizeiptr(data.size()), data.data(), 0);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  return bufferObject;
+}
+
+std::vector<GLuint> SceneResources::createPackedVertexArrayObjects(
+    const PackedGeometry &geometry, GLsizei drawCount, std::vector<GLuint> &bufferObjects) const
+{
+  TRACE_ZONE("createPackedVertexArrayObjects");
+  const GLuint VERTEX_ATTRIB_DRAW_ID_IDX = 3; // Attributes of the pools use locations 0 to 2
+  const GLuint VERTEX_BINDING_IDX = 0;
+  const GLuint DRAW_ID_BINDING_IDX = 1;
+
+  // Draw ids are fetched once per instance from baseInstance, so the buffer
+  // simply contains 0, 1, ..., drawCount - 1
+  std::vector<GLuint> drawIds(drawCount);
+  std::iota(begin(drawIds), end(drawIds), 0);
+
+  const auto createBuffer = [&](const void *data, size_t size) {
+    GLuint bufferObject = 0;
+    glGenBuffers(1, &bufferObject);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+    if (size)
+    {
+      glBufferStorage(GL_ARRAY_BUFFER, GLsizeiptr(size), data, 0);
+    }
+    bufferObjects.emplace_back(bufferObject);
+    return bufferObject;
+  };
+  const auto drawIdBuffer = createBuffer(drawIds.data(), drawIds.size() * sizeof(GLuint));
+  const auto indexBuffer = createBuffer(geometry.indices.data, geometry.indices.size);
+
+  std::vector<GLuint> vertexArrayObjects(geometry.vertexPools.size(), 0);
+  glGenVertexArrays(GLsizei(vertexArrayObjects.size()), vertexArrayObjects.data());
+  for (size_t poolIdx = 0; poolIdx < geometry.vertexPools.size(); ++poolIdx)
+  {
+    const auto &pool = geometry.vertexPools[poolIdx];
+    glBindVertexArray(vertexArrayObjects[poolIdx]);
+
+    // Attributes keep the component type of their accessors, the ones
+    // missing from the pool are disabled
+    glBindVertexBuffer(VERTEX_BINDING_IDX, createBuffer(pool.vertices.data, pool.vertices.size), 0, GLsizei(pool.stride));
+    for (size_t attributeIdx = 0; attributeIdx < pool.attributes.size(); ++attributeIdx)
+    {
+      const auto &attribute = pool.attributes[attributeIdx];
+      if (attribute.componentType)
+      {
+        glEnableVertexAttribArray(GLuint(attributeIdx));
+        glVertexAttribFormat(GLuint(attributeIdx), attribute.componentCount, GLenum(attribute.componentType),
+            attribute.normalized ? GL_TRUE : GL_FALSE, attribute.offset);
+        glVertexAttribBinding(GLuint(attributeIdx), VERTEX_BINDING_IDX);
+      }
+    }
+
+    glBindVertexBuffer(DRAW_ID_BINDING_IDX, drawIdBuffer, 0, GLsizei(sizeof(GLuint)));
+    glEnableVertexAttribArray(VERTEX_ATTRIB_DRAW_ID_IDX);
+    glVertexAttribIFormat(VERTEX_ATTRIB_DRAW_ID_IDX, 1, GL_UNSIGNED_INT, 0);
+    glVertexAttribBinding(VERTEX_ATTRIB_DRAW_ID_IDX, DRAW_ID_BINDING_IDX);
+    glVertexBindingDivisor(DRAW_ID_BINDING_IDX, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  return vertexArrayObjects;
+}
+
+std::vector<GLuint> SceneResources::createTextureObjects(
+    const tinygltf::Model &model, const std::vector<BufferBytes> &imagePixels) const
+{
+  TRACE_ZONE("createTextureObjects");
+  std::vector<GLuint> textureObjects(model.textures.size(), 0);
+
+  tinygltf::Sampler defaultSampler;
+  defaultSampler.minFilter = GL_LINEAR;
+  defaultSampler.magFilter = GL_LINEAR;
+  defaultSampler.wrapS = GL_REPEAT;
+  defaultSampler.wrapT = GL_REPEAT;
+  defaultSampler.wrapR = GL_REPEAT;
+
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(GLsizei(model.textures.size()), textureObjects.data());
+
+  // Images are uploaded with their own number of channels, rows of RGB or
+  // single channel images are not necessarily 4 bytes aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  for (size_t i = 0; i < model.textures.size(); i++)
+  {
+    const auto &texture = model.textures[i];
+    const auto &image = model.images[texture.source];
+
+    const auto &sampler = texture.sampler >= 0 ? model.samplers[texture.sampler] : defaultSampler;
+
+    glBindTexture(GL_TEXTURE_2D, textureObjects[i]);
+
+    const auto useMipmaps = sampler.minFilter == GL_NEAREST_MIPMAP_NEAREST || sampler.minFilter == GL_NEAREST_MIPMAP_LINEAR ||
+                            sampler.minFilter == GL_LINEAR_MIPMAP_NEAREST || sampler.minFilter == GL_LINEAR_MIPMAP_LINEAR;
+
+    const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    const auto format = image.component >= 1 && image.component <= 4 ? formats[image.component - 1] : GL_RGBA;
+
+    const auto pixels = imagePixels.empty() ? BufferBytes{image.image.data(), image.image.size()} : imagePixels[texture.source];
+    if (pixels.size)
+    {
+      glTexImage2D(GL_TEXTURE_2D, 0, GLint(format), image.width, image.height, 0, format, image.pixel_type, pixels.data);
+      if (useMipmaps)
+      {
+        glGenerateMipmap(GL_TEXTURE_2D);
+      }
+    }
+
+    // Expand grey and grey-alpha images like RGBA decoding would do
+    if (image.component == 1)
+    {
+      const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+      glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    } else if (image.component == 2)
+    {
+      const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+      glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter != -1 ? sampler.minFilter : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter != -1 ? sampler.magFilter : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, sampler.wrapR);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  return textureObjects;
+}
+
+SceneResources::SceneResources(const LoadedScene &scene, StartupProfiler &profiler) : m_Scene(scene)
+{
+  const auto &model = scene.model;
+  const auto &sceneCache = scene.sceneCache;
+  const auto &packedGeometry = scene.packedGeometry;
+  const auto &sceneGraph = scene.sceneGraph;
+
+  profiler.beginPhase("create_texture_objects");
+  m_TextureObjects = createTextureObjects(model, sceneCache.imagePixels);
+  {
+    uint64_t textureBytes = getTotalSize(sceneCache.imagePixels);
+    for (const auto &image : model.images)
+    {
+      textureBytes += image.image.size();
+    }
+    profiler.endPhase(textureBytes);
+    m_nByteSize += textureBytes;
+  }
+
+  glGenTextures(1, &m_WhiteTexture);
+  glBindTexture(GL_TEXTURE_2D, m_WhiteTexture);
+  float white[] = {1, 1, 1, 1};
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, white);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // All primitives are drawn from the geometry pools, with a vertex array
+  // object per pool
+  for (const auto nodeIdx : sceneGraph.meshNodes())
+  {
+    m_nDrawCount += model.meshes[sceneGraph.nodes()[nodeIdx].mesh].primitives.size();
+  }
+
+  profiler.beginPhase("create_vertex_array_objects");
+  m_PackedVertexArrayObjects = createPackedVertexArrayObjects(packedGeometry, GLsizei(m_nDrawCount), m_BufferObjects);
+  profiler.endPhase(packedGeometry.byteSize());
+  m_nByteSize += packedGeometry.byteSize() + m_nDrawCount * sizeof(GLuint);
+
+  profiler.beginPhase("create_material_buffer_object");
+  m_MaterialBufferObject = createMaterialBufferObject(model, m_MaterialBlockStride);
+  profiler.endPhase((model.materials.size() + 1) * m_MaterialBlockStride);
+  m_nByteSize += (model.materials.size() + 1) * m_MaterialBlockStride;
+}
+
+SceneResources::~SceneResources()
+{
+  glDeleteBuffers(1, &m_MaterialBufferObject);
+  glDeleteVertexArrays(GLsizei(m_PackedVertexArrayObjects.size()), m_PackedVertexArrayObjects.data());
+  glDeleteBuffers(GLsizei(m_BufferObjects.size()), m_BufferObjects.data());
+  glDeleteTextures(1, &m_WhiteTexture);
+  glDeleteTextures(GLsizei(m_TextureObjects.size()), m_TextureObjects.data());
+}
+
+void SceneResources::bindMaterialBlock(GLuint binding, int materialIndex) const
+{
+  glBindBufferRange(
+      GL_UNIFORM_BUFFER, binding, m_MaterialBufferObject, (materialIndex + 1) * m_MaterialBlockStride, sizeof(MaterialBlock));
+}
+
+SceneRenderer::SceneRenderer(const SceneResources &resources, const fs::path &vertexShader, const fs::path &fragmentShader,
+    bool multiDrawIndirect, StartupProfiler &profiler) :
+    m_Resources(resources), m_Scene(resources.scene()), m_bMultiDrawIndirect(multiDrawIndirect)
+{
+  // Loader shaders
+  profiler.beginPhase("compile_program");
+  m_Program = compileProgram({vertexShader, fragmentShader});
+  profiler.endPhase(fs::file_size(vertexShader) + fs::file_size(fragmentShader));
+
+  const auto programId = m_Program.glId();
+  m_ModelViewProjMatrixLocation = glGetUniformLocation(programId, "uModelViewProjMatrix");
+  m_ModelViewMatrixLocation = glGetUniformLocation(programId, "uModelViewMatrix");
+  m_NormalMatrixLocation = glGetUniformLocation(programId, "uNormalMatrix");
+  m_ViewMatrixLocation = glGetUniformLocation(programId, "uViewMatrix");
+  m_ProjMatrixLocation = glGetUniformLocation(programId, "uProjMatrix");
+  m_LightingDirectionLocation = glGetUniformLocation(programId, "uLightDirection");
+  m_LightingIntensityLocation = glGetUniformLocation(programId, "uLightIntensity");
+  m_BaseColorTextureLocation = glGetUniformLocation(programId, "uBaseColorTexture");
+  m_MetallicRoughnessTextureLocation = glGetUniformLocation(programId, "uMetallicRoughnessTexture");
+  m_EmissiveTextureLocation = glGetUniformLocation(programId, "uEmissiveTexture");
+  m_OcclusionTextureLocation = glGetUniformLocation(programId, "uOcclusionTexture");
+  m_ApplyOcclusionLocation = glGetUniformLocation(programId, "uApplyOcclusion");
+  m_ObjectIdsLocation = glGetUniformLocation(programId, "uObjectIds");
+  m_MaterialBlockIndex = glGetUniformBlockIndex(programId, "Material");
+
+  const auto maxDistance = glm::length(m_Scene.bboxMax - m_Scene.bboxMin);
+  m_fMaxDistance = maxDistance > 0.f ? maxDistance : 100.f;
+  m_fFarPlane = 1.5f * m_fMaxDistance;
+
+  if (m_bMultiDrawIndirect)
+  {
+    glGenBuffers(1, &m_DrawTransformBufferObject);
+    glGenBuffers(1, &m_DrawCommandBufferObject);
+    m_DrawTransforms.reserve(resources.drawCount());
+    m_DrawCommands.reserve(resources.drawCount());
+  }
+
+  // Program state set once, it is kept by the program object
+  m_Program.use();
+  if (m_MaterialBlockIndex != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(programId, m_MaterialBlockIndex, MATERIAL_BLOCK_BINDING);
+  }
+  glUniform1i(m_BaseColorTextureLocation, BASE_COLOR_TEXTURE_UNIT);
+  glUniform1i(m_MetallicRoughnessTextureLocation, METALLIC_ROUGHNESS_TEXTURE_UNIT);
+  glUniform1i(m_EmissiveTextureLocation, EMISSIVE_TEXTURE_UNIT);
+  glUniform1i(m_OcclusionTextureLocation, OCCLUSION_TEXTURE_UNIT);
+}
+
+SceneRenderer::~SceneRenderer()
+{
+  glDeleteBuffers(1, &m_DrawCommandBufferObject);
+  glDeleteBuffers(1, &m_DrawTransformBufferObject);
+}
+
+glm::mat4 SceneRenderer::getProjectionMatrix(float aspectRatio) const
+{
+  return glm::perspective(70.f, aspectRatio, 0.001f * m_fMaxDistance, m_fFarPlane);
+}
+
+glm::uvec4 SceneRenderer::getObjectIds(uint32_t nodeIdx, uint32_t primitiveIdx, int materialIdx)
+{
+  return glm::uvec4(nodeIdx + 1, primitiveIdx + 1, uint32_t(materialIdx + 1), 0);
+}
+
+std::string SceneRenderer::getMaterialName(int materialIdx) const
+{
+  if (materialIdx < 0)
+  {
+    return "default material";
+  }
+  const auto &name = m_Scene.model.materials[materialIdx].name;
+  return name.empty() ? "material " + std::to_string(materialIdx) : name;
+}
+
+std::string SceneRenderer::getDrawName(const SceneGraph::Node &node, uint32_t primitiveIdx) const
+{
+  const auto &model = m_Scene.model;
+  const auto &mesh = model.meshes[node.mesh];
+  const auto &nodeName = model.nodes[node.gltfNode].name;
+  return (nodeName.empty() ? "node " + std::to_string(node.gltfNode) : nodeName) + " / " +
+         (mesh.name.empty() ? "mesh " + std::to_string(node.mesh) : mesh.name) + "[" + std::to_string(primitiveIdx) + "] / " +
+         getMaterialName(mesh.primitives[primitiveIdx].material);
+}
+
+void SceneRenderer::bindTexture(GLint unit, GLuint textureObject)
+{
+  if (m_BoundTextures[unit] != textureObject)
+  {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, textureObject);
+    m_BoundTextures[unit] = textureObject;
+    ++m_LastDrawStats.stateChanges;
+  }
+}
+
+void SceneRenderer::bindMaterial(int materialIndex)
+{
+  const auto &model = m_Scene.model;
+  const auto &textureObjects = m_Resources.textureObjects();
+
+  // Material binding: factors are selected in the material buffer, only
+  // textures are bound per material
+  if (m_MaterialBlockIndex != GL_INVALID_INDEX)
+  {
+    m_Resources.bindMaterialBlock(MATERIAL_BLOCK_BINDING, materialIndex);
+    ++m_LastDrawStats.stateChanges;
+  }
+
+  if (materialIndex >= 0)
+  {
+    const auto &material = model.materials[materialIndex];
+    const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+
+    if (m_BaseColorTextureLocation >= 0)
+    {
+      auto textureObject = m_Resources.whiteTexture();
+      if (pbrMetallicRoughness.baseColorTexture.index >= 0)
+      {
+        const auto &texture = model.textures[pbrMetallicRoughness.baseColorTexture.index];
+
+        if (texture.source >= 0)
+        {
+          textureObject = textureObjects[texture.source];
+        }
+      }
+      bindTexture(BASE_COLOR_TEXTURE_UNIT, textureObject);
+    }
+
+    if (m_MetallicRoughnessTextureLocation >= 0)
+    {
+      // Bind 0 when there is no texture, so that the result does not depend
+      // on the previously drawn material
+      auto metallicRoughnessObject = 0u;
+      if (pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
+      {
+        const auto &metallicRoughness = model.textures[pbrMetallicRoughness.metallicRoughnessTexture.index];
+        if (metallicRoughness.source >= 0)
+        {
+          metallicRoughnessObject = textureObjects[metallicRoughness.source];
+        }
+      }
+      bindTexture(METALLIC_ROUGHNESS_TEXTURE_UNIT, metallicRoughnessObject);
+    }
+
+    if (m_EmissiveTextureLocation >= 0)
+    {
+      auto emissiveObject = 0u;
+      if (material.emissiveTexture.index >= 0)
+      {
+        const auto &texture = model.textures[material.emissiveTexture.index];
+        if (texture.source >= 0)
+        {
+          emissiveObject = textureObjects[texture.source];
+        }
+      }
+      bindTexture(EMISSIVE_TEXTURE_UNIT, emissiveObject);
+    }
+
+    if (m_OcclusionTextureLocation >= 0)
+    {
+      auto occlusionObject = m_Resources.whiteTexture();
+      if (material.occlusionTexture.index >= 0)
+      {
+        const auto &texture = model.textures[material.occlusionTexture.index];
+        if (texture.source >= 0)
+        {
+          occlusionObject = textureObjects[texture.source];
+        }
+      }
+      bindTexture(OCCLUSION_TEXTURE_UNIT, occlusionObject);
+    }
+
+  } else
+  {
+    if (m_BaseColorTextureLocation >= 0)
+    {
+      bindTexture(BASE_COLOR_TEXTURE_UNIT, m_Resources.whiteTexture());
+    }
+
+    if (m_MetallicRoughnessTextureLocation >= 0)
+    {
+      bindTexture(METALLIC_ROUGHNESS_TEXTURE_UNIT, 0);
+    }
+
+    if (m_EmissiveTextureLocation >= 0)
+    {
+      bindTexture(EMISSIVE_TEXTURE_UNIT, 0);
+    }
+
+    if (m_OcclusionTextureLocation >= 0)
+    {
+      bindTexture(OCCLUSION_TEXTURE_UNIT, 0);
+    }
+  }
+}
+
+void SceneRenderer::draw(const Camera &camera, const glm::mat4 &projMatrix, GLsizei width, GLsizei height, const Lighting &lighting)
+{
+  TRACE_ZONE("drawScene");
+  const auto &model = m_Scene.model;
+  const auto &packedGeometry = m_Scene.packedGeometry;
+  const auto &sceneGraph = m_Scene.sceneGraph;
+
+  // Several renderers may share the context
+  glEnable(GL_DEPTH_TEST);
+  m_Program.use();
+
+  glViewport(0, 0, width, height);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  m_LastDrawStats = DrawStats{};
+
+  const auto viewMatrix = camera.getViewMatrix();
+
+  if (m_LightingDirectionLocation >= 0)
+  {
+    const auto lightDirectionInViewSpace =
+        lighting.fromCamera ? glm::vec3(0, 0, 1) : glm::normalize(glm::vec3(viewMatrix * glm::vec4(lighting.direction, 0.)));
+    glUniform3f(m_LightingDirectionLocation, lightDirectionInViewSpace[0], lightDirectionInViewSpace[1], lightDirectionInViewSpace[2]);
+  }
+
+  if (m_LightingIntensityLocation >= 0)
+  {
+    glUniform3f(m_LightingIntensityLocation, lighting.intensity[0], lighting.intensity[1], lighting.intensity[2]);
+  }
+
+  if (m_ApplyOcclusionLocation >= 0)
+  {
+    glUniform1i(m_ApplyOcclusionLocation, lighting.applyOcclusion);
+  }
+
+  // Draw the scene referenced by gltf file: world matrices are cached in
+  // the scene graph, only view dependent matrices are computed here.
+  // Draws are sorted by state first, so that state is only changed when
+  // needed, then front to back.
+  const auto &sceneNodes = sceneGraph.nodes();
+
+  m_RenderQueue.clear();
+  for (const auto nodeIdx : sceneGraph.meshNodes())
+  {
+    const auto &node = sceneNodes[nodeIdx];
+    const auto viewDepth = -(viewMatrix * node.worldMatrix[3]).z;
+    const auto &mesh = model.meshes[node.mesh];
+    const auto &ranges = packedGeometry.meshPrimitiveRanges[node.mesh];
+    for (size_t primIdx = 0; primIdx < mesh.primitives.size(); primIdx++)
+    {
+      const auto vertexArrayObject = m_Resources.vertexArrayObjects()[ranges[primIdx].pool];
+      m_RenderQueue.push(RenderQueue::makeKey(0, mesh.primitives[primIdx].material, vertexArrayObject, viewDepth / m_fFarPlane),
+          uint32_t(nodeIdx), uint32_t(primIdx));
+    }
+  }
+  m_RenderQueue.sort();
+
+  // Other code (e.g. ImGui) might have changed bindings since last frame
+  m_BoundTextures.fill(std::numeric_limits<GLuint>::max());
+
+  if (m_bMultiDrawIndirect)
+  {
+    // Consecutive draws sharing material, mode and vertex pool form a
+    // bucket, submitted with a single glMultiDrawElementsIndirect call
+    m_DrawTransforms.clear();
+    m_DrawCommands.clear();
+    m_DrawBuckets.clear();
+    for (const auto &item : m_RenderQueue.items())
+    {
+      const auto &node = sceneNodes[item.node];
+      const auto &primitive = model.meshes[node.mesh].primitives[item.primitive];
+      const auto &range = packedGeometry.meshPrimitiveRanges[node.mesh][item.primitive];
+
+      if (m_DrawBuckets.empty() || m_DrawBuckets.back().material != primitive.material || m_DrawBuckets.back().mode != primitive.mode ||
+          m_DrawBuckets.back().pool != range.pool)
+      {
+        m_DrawBuckets.push_back({primitive.material, primitive.mode, range.pool, GLsizei(m_DrawCommands.size()), 0});
+      }
+      ++m_DrawBuckets.back().commandCount;
+      m_LastDrawStats.triangles += countTriangles(primitive.mode, range.indexCount);
+
+      m_DrawCommands.push_back({range.indexCount, 1, range.firstIndex, range.baseVertex, GLuint(m_DrawTransforms.size())});
+      m_DrawTransforms.push_back(
+          {node.worldMatrix, glm::mat4(node.worldNormalMatrix), getObjectIds(uint32_t(node.gltfNode), item.primitive, primitive.material)});
+    }
+
+    glUniformMatrix4fv(m_ViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+    glUniformMatrix4fv(m_ProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(projMatrix));
+
+    // Buffers are respecified each frame so that the driver can hand out new
+    // storage instead of waiting for the previous frame
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_DrawTransformBufferObject);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_DrawTransforms.size() * sizeof(DrawTransform), m_DrawTransforms.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_TRANSFORMS_BINDING, m_DrawTransformBufferObject);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_DrawCommandBufferObject);
+    glBufferData(
+        GL_DRAW_INDIRECT_BUFFER, m_DrawCommands.size() * sizeof(DrawElementsIndirectCommand), m_DrawCommands.data(), GL_STREAM_DRAW);
+
+    const auto indexType = GLenum(packedGeometry.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+    const auto drawScopes = m_pGpuProfiler && m_pGpuProfiler->drawScopesEnabled();
+    auto currentPool = std::numeric_limits<uint32_t>::max();
+    auto currentMaterial = std::numeric_limits<int>::min();
+    for (const auto &bucket : m_DrawBuckets)
+    {
+      if (bucket.pool != currentPool)
+      {
+        currentPool = bucket.pool;
+        glBindVertexArray(m_Resources.vertexArrayObjects()[bucket.pool]);
+        ++m_LastDrawStats.stateChanges;
+      }
+      if (bucket.material != currentMaterial)
+      {
+        currentMaterial = bucket.material;
+        bindMaterial(bucket.material);
+      }
+      ScopedGpuTimer timer{drawScopes ? m_pGpuProfiler : nullptr,
+          drawScopes ? getMaterialName(bucket.material) + " (" + std::to_string(bucket.commandCount) + " draws)" : std::string{}};
+      glMultiDrawElementsIndirect(bucket.mode, indexType,
+          (const GLvoid *)(bucket.firstCommand * sizeof(DrawElementsIndirectCommand)), bucket.commandCount, 0);
+      ++m_LastDrawStats.drawCalls;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    return;
+  }
+
+  const auto viewRotation = glm::mat3(viewMatrix);
+  auto currentNode = std::numeric_limits<uint32_t>::max();
+  auto currentMaterial = std::numeric_limits<int>::min();
+  auto currentPool = std::numeric_limits<uint32_t>::max();
+  const auto indexType = GLenum(packedGeometry.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+  const auto drawScopes = m_pGpuProfiler && m_pGpuProfiler->drawScopesEnabled();
+  for (const auto &item : m_RenderQueue.items())
+  {
+    const auto &node = sceneNodes[item.node];
+    const auto &primitive = model.meshes[node.mesh].primitives[item.primitive];
+
+    if (item.node != currentNode)
+    {
+      currentNode = item.node;
+
+      const glm::mat4 modelViewMatrix = viewMatrix * node.worldMatrix;
+
+      const glm::mat4 modelViewProjectionMatrix = projMatrix * modelViewMatrix;
+
+      // The view matrix is a rigid transform, its normal matrix is itself
+      const glm::mat4 normalMatrix = glm::mat4(viewRotation * node.worldNormalMatrix);
+
+      glUniformMatrix4fv(m_ModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewMatrix));
+      glUniformMatrix4fv(m_ModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewProjectionMatrix));
+      glUniformMatrix4fv(m_NormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    }
+
+    if (primitive.material != currentMaterial)
+    {
+      currentMaterial = primitive.material;
+      bindMaterial(primitive.material);
+    }
+
+    if (m_ObjectIdsLocation >= 0)
+    {
+      const auto objectIds = getObjectIds(uint32_t(node.gltfNode), item.primitive, primitive.material);
+      glUniform3ui(m_ObjectIdsLocation, objectIds.x, objectIds.y, objectIds.z);
+    }
+
+    const auto &range = packedGeometry.meshPrimitiveRanges[node.mesh][item.primitive];
+    if (range.pool != currentPool)
+    {
+      currentPool = range.pool;
+      glBindVertexArray(m_Resources.vertexArrayObjects()[range.pool]);
+      ++m_LastDrawStats.stateChanges;
+    }
+
+    ScopedGpuTimer timer{drawScopes ? m_pGpuProfiler : nullptr, drawScopes ? getDrawName(node, item.primitive) : std::string{}};
+    glDrawElementsBaseVertex(primitive.mode, GLsizei(range.indexCount), indexType,
+        (const GLvoid *)(size_t(range.firstIndex) * packedGeometry.indexSize), range.baseVertex);
+    m_LastDrawStats.triangles += countTriangles(primitive.mode, range.indexCount);
+    ++m_LastDrawStats.drawCalls;
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
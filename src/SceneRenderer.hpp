@@ -0,0 +1,258 @@
+#pragma once
+
+#include "utils/cameras.hpp"
+#include "utils/filesystem.hpp"
+#include "utils/gltf.hpp"
+#include "utils/gpu_profiler.hpp"
+#include "utils/packed_geometry.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/scene_cache.hpp"
+#include "utils/scene_graph.hpp"
+#include "utils/shaders.hpp"
+#include "utils/startup_profiler.hpp"
+#include <tiny_gltf.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// CPU side data of a scene. Only read once loaded, so that render contexts of
+// several threads can share it.
+struct LoadedScene
+{
+  tinygltf::Model model;
+  GltfBuffers buffers;
+  SceneCache sceneCache;
+  SceneGraph sceneGraph;
+  PackedGeometry packedGeometry;
+  std::vector<std::vector<Bounds>> meshPrimitiveBounds; // Local bounds, see computePrimitiveBounds()
+  glm::vec3 bboxMin, bboxMax;
+
+  // Camera looking at the center of the scene bounding box
+  Camera getDefaultCamera() const;
+
+  // Approximate memory used by buffers and images
+  uint64_t byteSize() const;
+
+  // Free image pixels, buffer bytes and packed geometry, and unmap files.
+  // Drawing only reads the structure of the model (nodes, meshes and
+  // materials), so this can be called once the SceneResources of the scene
+  // are created. No SceneResources can be created from the scene afterwards.
+  void releaseUploadedData();
+};
+
+// Load the scene of gltfFile, from the scene cache if cacheDirectory is not
+// empty and the file has been cached. Phases are recorded in profiler.
+bool loadScene(const fs::path &gltfFile, const fs::path &cacheDirectory, StartupProfiler &profiler, LoadedScene &scene);
+
+// GPU objects of a loaded scene in the current context: textures, material
+// buffer and geometry pools. They do not depend on the program drawing them,
+// so that the renderers of several shader pairs share them. The scene must
+// outlive them.
+class SceneResources
+{
+public:
+  // Upload the scene. Phases are recorded in profiler.
+  SceneResources(const LoadedScene &scene, StartupProfiler &profiler);
+
+  // GPU objects are deleted, the context must be current
+  ~SceneResources();
+
+  // Non-copyable class:
+  SceneResources(const SceneResources &) = delete;
+  SceneResources &operator=(const SceneResources &) = delete;
+
+  const LoadedScene &scene() const { return m_Scene; }
+
+  // Approximate memory used by GPU objects
+  uint64_t byteSize() const { return m_nByteSize; }
+
+  // Number of primitives drawn for the scene graph, one per mesh node
+  // primitive
+  size_t drawCount() const { return m_nDrawCount; }
+
+  // Indexed like model.textures
+  const std::vector<GLuint> &textureObjects() const { return m_TextureObjects; }
+
+  // Bound in place of missing base color and occlusion textures
+  GLuint whiteTexture() const { return m_WhiteTexture; }
+
+  // Indexed like PackedGeometry::vertexPools, see createPackedVertexArrayObjects()
+  const std::vector<GLuint> &vertexArrayObjects() const { return m_PackedVertexArrayObjects; }
+
+  // Bind the block of a material (-1 for the default material) to a uniform
+  // buffer binding point
+  void bindMaterialBlock(GLuint binding, int materialIndex) const;
+
+private:
+  // Material factors, laid out as the std140 "Material" uniform block of
+  // pbr_directional_light.fs.glsl
+  struct MaterialBlock
+  {
+    float baseColorFactor[4];
+    float emissiveFactor[3];
+    float metallicFactor;
+    float roughnessFactor;
+    float occlusionStrength;
+    float padding[2]; // std140 rounds the size of the block up to a vec4
+  };
+
+  // All materials in a single uniform buffer, preceded by a default material.
+  // The block of material i starts at (i + 1) * blockStride.
+  GLuint createMaterialBufferObject(const tinygltf::Model &model, GLsizeiptr &blockStride) const;
+  // Geometry pools of the scene: a vertex buffer per pool of vertices, an
+  // index buffer holding all indices and a vertex array object per pool
+  // reading them, with an additional per instance attribute for the draw
+  // index of the multi draw indirect path. Primitives are drawn with their
+  // range of the geometry, as base vertex draws. Created buffers are appended
+  // to bufferObjects.
+  std::vector<GLuint> createPackedVertexArrayObjects(
+      const PackedGeometry &geometry, GLsizei drawCount, std::vector<GLuint> &bufferObjects) const;
+  // Images are uploaded from imagePixels when it is not empty (model loaded
+  // from the scene cache), from model.images otherwise. Mip levels are
+  // generated in both cases.
+  std::vector<GLuint> createTextureObjects(const tinygltf::Model &model, const std::vector<BufferBytes> &imagePixels) const;
+
+  const LoadedScene &m_Scene;
+  uint64_t m_nByteSize = 0;
+  size_t m_nDrawCount = 0;
+
+  std::vector<GLuint> m_TextureObjects;
+  GLuint m_WhiteTexture = 0;
+
+  std::vector<GLuint> m_BufferObjects;
+  std::vector<GLuint> m_PackedVertexArrayObjects;
+
+  GLuint m_MaterialBufferObject = 0;
+  GLsizeiptr m_MaterialBlockStride = 0;
+};
+
+// Program drawing the GPU objects of a scene in the current context. The
+// resources must outlive the renderer.
+class SceneRenderer
+{
+public:
+  struct Lighting
+  {
+    glm::vec3 direction{1, 1, 1};
+    glm::vec3 intensity{1, 1, 1};
+    bool fromCamera = false;
+    bool applyOcclusion = true;
+  };
+
+  // Compile the program. Throw std::runtime_error if it does not compile.
+  // Phases are recorded in profiler.
+  SceneRenderer(const SceneResources &resources, const fs::path &vertexShader, const fs::path &fragmentShader, bool multiDrawIndirect,
+      StartupProfiler &profiler);
+
+  // GPU objects are deleted, the context must be current
+  ~SceneRenderer();
+
+  // Non-copyable class:
+  SceneRenderer(const SceneRenderer &) = delete;
+  SceneRenderer &operator=(const SceneRenderer &) = delete;
+
+  // Length of the diagonal of the scene bounding box, 100 if it is empty
+  float maxDistance() const { return m_fMaxDistance; }
+
+  glm::mat4 getProjectionMatrix(float aspectRatio) const;
+
+  // Draw the scene in the currently bound framebuffer. World matrices are
+  // those of the scene graph: call its updateWorldMatrices() after changing
+  // it.
+  void draw(const Camera &camera, const glm::mat4 &projMatrix, GLsizei width, GLsizei height, const Lighting &lighting);
+
+  // Work submitted by a draw()
+  struct DrawStats
+  {
+    uint32_t drawCalls = 0;
+    uint64_t triangles = 0;
+    uint32_t stateChanges = 0; // Vertex array, material and texture bindings
+  };
+
+  const DrawStats &lastDrawStats() const { return m_LastDrawStats; }
+
+  // When draw scopes of profiler are enabled, each draw call (each multi draw
+  // call on the multi draw indirect path) is timed in its own scope. profiler
+  // can be null.
+  void setGpuProfiler(GpuProfiler *profiler) { m_pGpuProfiler = profiler; }
+
+private:
+  // Per draw data of the multi draw indirect path, read by
+  // forward_indirect.vs.glsl
+  struct DrawTransform
+  {
+    glm::mat4 modelMatrix;
+    glm::mat4 normalMatrix;
+    glm::uvec4 objectIds; // See getObjectIds()
+  };
+
+  // Layout imposed by glMultiDrawElementsIndirect
+  struct DrawElementsIndirectCommand
+  {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance; // Index of the draw, see forward_indirect.vs.glsl
+  };
+
+  // Consecutive indirect commands sharing material, primitive mode and
+  // vertex pool
+  struct DrawBucket
+  {
+    int material;
+    int mode;
+    uint32_t pool; // Index in PackedGeometry::vertexPools
+    GLsizei firstCommand;
+    GLsizei commandCount;
+  };
+
+  // Texture objects bound to each unit are tracked, so that textures shared by
+  // consecutive materials are not bound again
+  void bindTexture(GLint unit, GLuint textureObject);
+  void bindMaterial(int materialIndex);
+
+  // Indices + 1 of the glTF node, primitive and material of a draw, written
+  // by shaders with arbitrary outputs so that 0 identifies the background
+  // (and the default material)
+  static glm::uvec4 getObjectIds(uint32_t nodeIdx, uint32_t primitiveIdx, int materialIdx);
+
+  // Names of GPU profiler scopes
+  std::string getMaterialName(int materialIdx) const;
+  std::string getDrawName(const SceneGraph::Node &node, uint32_t primitiveIdx) const;
+
+  const SceneResources &m_Resources;
+  const LoadedScene &m_Scene;
+  const bool m_bMultiDrawIndirect;
+  float m_fMaxDistance = 100.f;
+  float m_fFarPlane = 150.f;
+
+  GLProgram m_Program;
+  GLint m_ModelViewProjMatrixLocation = -1;
+  GLint m_ModelViewMatrixLocation = -1;
+  GLint m_NormalMatrixLocation = -1;
+  GLint m_ViewMatrixLocation = -1;
+  GLint m_ProjMatrixLocation = -1;
+  GLint m_LightingDirectionLocation = -1;
+  GLint m_LightingIntensityLocation = -1;
+  GLint m_BaseColorTextureLocation = -1;
+  GLint m_MetallicRoughnessTextureLocation = -1;
+  GLint m_EmissiveTextureLocation = -1;
+  GLint m_OcclusionTextureLocation = -1;
+  GLint m_ApplyOcclusionLocation = -1;
+  GLint m_ObjectIdsLocation = -1;
+  GLuint m_MaterialBlockIndex = GL_INVALID_INDEX;
+
+  // Multi draw indirect path: per draw data is streamed each frame
+  GLuint m_DrawTransformBufferObject = 0;
+  GLuint m_DrawCommandBufferObject = 0;
+  std::vector<DrawTransform> m_DrawTransforms;
+  std::vector<DrawElementsIndirectCommand> m_DrawCommands;
+  std::vector<DrawBucket> m_DrawBuckets;
+
+  std::array<GLuint, 4> m_BoundTextures;
+  RenderQueue m_RenderQueue;
+  DrawStats m_LastDrawStats;
+  GpuProfiler *m_pGpuProfiler = nullptr;
+};
@@ -1,19 +1,26 @@
 #include "ViewerApplication.hpp"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
 #include <iostream>
-#include <numeric>
+#include <thread>
 
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
-#include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/io.hpp>
 
+#include "utils/camera_batch.hpp"
 #include "utils/cameras.hpp"
-#include "utils/gltf.hpp"
-#include "utils/images.hpp"
-
-#include <stb_image_write.h>
-#include <tiny_gltf.h>
+#include "utils/egl_context.hpp"
+#include "utils/frame_readback.hpp"
+#include "utils/gpu_profiler.hpp"
+#include "utils/image_writer.hpp"
+#include "utils/statistics.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/tracing.hpp"
 
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
@@ -23,543 +30,338 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
   }
 }
 
-bool ViewerApplication::loadGltfFile(tinygltf::Model &model)
+// Path of an arbitrary output variable written next to an offscreen image
+static fs::path getAovPath(const fs::path &outputPath, const char *name)
 {
-  tinygltf::TinyGLTF loader;
-  std::string warn;
-  std::string err;
-  bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, m_gltfFilePath.string());
+  return outputPath.parent_path() / (outputPath.stem().string() + "." + name + ".pfm");
+}
 
-  if (!warn.empty())
+Camera ViewerApplication::getInitialCamera(const LoadedScene &scene) const
+{
+  return m_hasUserCamera ? m_userCamera : scene.getDefaultCamera();
+}
+
+int ViewerApplication::run()
+{
+  LoadedScene scene;
+  if (!loadScene(m_gltfFilePath, m_CacheDirectory, m_StartupProfiler, scene))
   {
-    std::cout << "Warn : " << warn << std::endl;
+    return -1;
   }
 
-  if (!err.empty())
+  if (m_OutputPath.empty() && m_CamerasPath.empty())
   {
-    std::cerr << "Error : " << err << std::endl;
+    return renderScene(scene, m_StartupProfiler, nullptr);
   }
 
-  if (!ret)
+  // Offscreen rendering: model and decoded data are shared by all poses, and
+  // by all render contexts
+  OffscreenJobs offscreenJobs;
+  if (!m_CamerasPath.empty())
+  {
+    std::string err;
+    if (!loadCameraJobs(m_CamerasPath, offscreenJobs.jobs, err))
+    {
+      std::cerr << "Error : " << err << std::endl;
+      return -1;
+    }
+  } else
   {
-    std::cerr << "Failed to parse the glTF file" << std::endl;
+    offscreenJobs.jobs.push_back({getInitialCamera(scene), m_OutputPath});
   }
 
-  return ret;
-}
-
-std::vector<GLuint> ViewerApplication::createBufferObjects(const tinygltf::Model &model) const
-{
-  std::vector<GLuint> buffers(model.buffers.size(), 0);
-  glGenBuffers(GLsizei(model.buffers.size()), buffers.data());
-  for (size_t i = 0; i < model.buffers.size(); i++)
   {
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
-    glBufferStorage(GL_ARRAY_BUFFER, model.buffers[i].data.size(), model.buffers[i].data.data(), 0);
+    std::string err;
+    if (!resolveImageFormat(offscreenJobs.jobs, err))
+    {
+      std::cerr << "Error : " << err << std::endl;
+      return -1;
+    }
   }
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  return buffers;
-}
-
-std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
-    const tinygltf::Model &model, const std::vector<GLuint> &bufferObjects, std::vector<VaoRange> &meshindexToVaoRange) const
-{
-  std::vector<GLuint> vertexArrayObjects;
-
-  meshindexToVaoRange.resize(model.meshes.size());
+  configureImageWriter(m_ImageWriterOptions);
+  ThreadPool encoder{m_EncodeThreadCount};
+  offscreenJobs.encoder = &encoder;
 
-  const GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
-  const GLuint VERTEX_ATTRIB_NORMAL_IDX = 1;
-  const GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
-
-  for (size_t i = 0; i < model.meshes.size(); i++)
+  const auto workerCount = std::min(m_RenderWorkerCount, offscreenJobs.jobs.size());
+  if (workerCount <= 1)
   {
-    const auto &mesh = model.meshes[i];
-
-    auto &vaoRange = meshindexToVaoRange[i];
-
-    vaoRange.begin = GLsizei(vertexArrayObjects.size());
-
-    vaoRange.count = GLsizei(mesh.primitives.size());
-
-    vertexArrayObjects.resize(vertexArrayObjects.size() + mesh.primitives.size());
-
-    glGenVertexArrays(vaoRange.count, &vertexArrayObjects[vaoRange.begin]);
+    return renderScene(scene, m_StartupProfiler, &offscreenJobs);
+  }
 
-    for (size_t idx = 0; idx < mesh.primitives.size(); idx++)
+#ifdef GLTF_VIEWER_USE_EGL
+  // Contexts are created here rather than by their thread because creation
+  // also loads the GL function pointers, which are global
+  std::vector<std::unique_ptr<EGLContextHandle>> contexts;
+  try
+  {
+    for (size_t i = 0; i < workerCount; ++i)
     {
-      const auto vao = vertexArrayObjects[vaoRange.begin + idx];
-      const auto &primitive = mesh.primitives[idx];
-      glBindVertexArray(vao);
-
-      {
-        const auto iterator = primitive.attributes.find("POSITION");
-
-        if (iterator != end(primitive.attributes))
-        {
-          const auto accessorIdx = (*iterator).second;
-          const auto &accessor = model.accessors[accessorIdx];
-          const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
-
-          glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION_IDX);
-          assert(GL_ARRAY_BUFFER == bufferView.target);
-          glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
-
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
-
-          glVertexAttribPointer(VERTEX_ATTRIB_POSITION_IDX, accessor.type, accessor.componentType, GL_FALSE, GLsizei(bufferView.byteStride),
-              (const GLvoid *)byteOffset);
-        }
-      }
-
-      {
-        const auto iterator = primitive.attributes.find("NORMAL");
-
-        if (iterator != end(primitive.attributes))
-        {
-          const auto accessorIdx = (*iterator).second;
-          const auto &accessor = model.accessors[accessorIdx];
-          const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
-
-          glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL_IDX);
-          assert(GL_ARRAY_BUFFER == bufferView.target);
-          glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
-
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
-
-          glVertexAttribPointer(VERTEX_ATTRIB_NORMAL_IDX, accessor.type, accessor.componentType, GL_FALSE, GLsizei(bufferView.byteStride),
-              (const GLvoid *)byteOffset);
-        }
-      }
-
-      {
-        const auto iterator = primitive.attributes.find("TEXCOORD_0");
-
-        if (iterator != end(primitive.attributes))
-        {
-          const auto accessorIdx = (*iterator).second;
-          const auto &accessor = model.accessors[accessorIdx];
-          const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
-
-          glEnableVertexAttribArray(VERTEX_ATTRIB_TEXCOORD0_IDX);
-          assert(GL_ARRAY_BUFFER == bufferView.target);
-          glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
-
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
-
-          glVertexAttribPointer(VERTEX_ATTRIB_TEXCOORD0_IDX, accessor.type, accessor.componentType, GL_FALSE,
-              GLsizei(bufferView.byteStride), (const GLvoid *)byteOffset);
-        }
-      }
-
-      if (primitive.indices >= 0)
-      {
-        const auto accessorIdx = primitive.indices;
-        const auto &accessor = model.accessors[accessorIdx];
-        const auto &bufferView = model.bufferViews[accessor.bufferView];
-        const auto bufferIdx = bufferView.buffer;
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObjects[bufferIdx]);
-      }
+      contexts.push_back(std::make_unique<EGLContextHandle>(4, 4, false));
+      contexts.back()->releaseCurrent();
     }
+  } catch (const std::runtime_error &)
+  {
+    std::cerr << "Warn : unable to create render contexts, rendering with a single one" << std::endl;
+    contexts.clear();
+    m_GLFWHandle.makeContextCurrent();
+    return renderScene(scene, m_StartupProfiler, &offscreenJobs);
   }
-  glBindVertexArray(0);
 
-  return vertexArrayObjects;
-}
-
-std::vector<GLuint> ViewerApplication::createTextureObjects(const tinygltf::Model &model) const
-{
-  std::vector<GLuint> textureObjects(model.textures.size(), 0);
-
-  tinygltf::Sampler defaultSampler;
-  defaultSampler.minFilter = GL_LINEAR;
-  defaultSampler.magFilter = GL_LINEAR;
-  defaultSampler.wrapS = GL_REPEAT;
-  defaultSampler.wrapT = GL_REPEAT;
-  defaultSampler.wrapR = GL_REPEAT;
-
-  glActiveTexture(GL_TEXTURE0);
-  glGenTextures(GLsizei(model.textures.size()), textureObjects.data());
-
-  for (size_t i = 0; i < model.textures.size(); i++)
+  // The first worker records the startup profile
+  std::vector<StartupProfiler> profilers(workerCount - 1, StartupProfiler{fs::path{}});
+  std::vector<int> returnCodes(workerCount, 0);
+  // Each context uploads the scene, it is never released
+  if (m_ReleaseCpuData)
   {
-    const auto &texture = model.textures[i];
-    const auto &image = model.images[texture.source];
-
-    const auto &sampler = texture.sampler >= 0 ? model.samplers[texture.sampler] : defaultSampler;
-
-    glBindTexture(GL_TEXTURE_2D, textureObjects[i]);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, image.pixel_type, image.image.data());
+    std::cerr << "Warn : CPU data of the scene is not released with several render workers" << std::endl;
+  }
+  offscreenJobs.sharedScene = true;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < workerCount; ++i)
+  {
+    workers.emplace_back([&, i]() {
+      setTraceThreadName("render worker " + std::to_string(i));
+      contexts[i]->makeCurrent();
+      returnCodes[i] = renderScene(scene, i == 0 ? m_StartupProfiler : profilers[i - 1], &offscreenJobs);
+      glFinish();
+      contexts[i]->releaseCurrent();
+    });
+  }
+  for (auto &worker : workers)
+  {
+    worker.join();
+  }
+  contexts.clear();
+  m_GLFWHandle.makeContextCurrent();
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter != -1 ? sampler.minFilter : GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter != -1 ? sampler.magFilter : GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, sampler.wrapR);
-    if (sampler.minFilter == GL_NEAREST_MIPMAP_NEAREST || sampler.minFilter == GL_NEAREST_MIPMAP_LINEAR ||
-        sampler.minFilter == GL_LINEAR_MIPMAP_NEAREST || sampler.minFilter == GL_LINEAR_MIPMAP_LINEAR)
+  for (const auto returnCode : returnCodes)
+  {
+    if (returnCode != 0)
     {
-      glGenerateMipmap(GL_TEXTURE_2D);
+      return returnCode;
     }
   }
-  glBindTexture(GL_TEXTURE_2D, 0);
-
-  return textureObjects;
+  return 0;
+#else
+  std::cerr << "Warn : render workers need headless contexts (GLTF_VIEWER_USE_EGL), rendering with a single context" << std::endl;
+  return renderScene(scene, m_StartupProfiler, &offscreenJobs);
+#endif
 }
 
-int ViewerApplication::run()
+int ViewerApplication::renderScene(LoadedScene &scene, StartupProfiler &profiler, OffscreenJobs *offscreenJobs)
 {
-  // Loader shaders
-  const auto glslProgram = compileProgram({m_ShadersRootPath / m_vertexShader, m_ShadersRootPath / m_fragmentShader});
-
-  const auto modelViewProjMatrixLocation = glGetUniformLocation(glslProgram.glId(), "uModelViewProjMatrix");
-  const auto modelViewMatrixLocation = glGetUniformLocation(glslProgram.glId(), "uModelViewMatrix");
-  const auto normalMatrixLocation = glGetUniformLocation(glslProgram.glId(), "uNormalMatrix");
-  const auto lightingDirectionLocation = glGetUniformLocation(glslProgram.glId(), "uLightDirection");
-  const auto lightingIntensityLocation = glGetUniformLocation(glslProgram.glId(), "uLightIntensity");
-  const auto uBaseColorTexture = glGetUniformLocation(glslProgram.glId(), "uBaseColorTexture");
-  const auto uBaseColorFactor = glGetUniformLocation(glslProgram.glId(), "uBaseColorFactor");
-  const auto uMetallicFactor = glGetUniformLocation(glslProgram.glId(), "uMetallicFactor");
-  const auto uRoughnessFactor = glGetUniformLocation(glslProgram.glId(), "uRoughnessFactor");
-  const auto uMetallicRoughnessTexture = glGetUniformLocation(glslProgram.glId(), "uMetallicRoughnessTexture");
-  const auto uEmissiveFactor = glGetUniformLocation(glslProgram.glId(), "uEmissiveFactor");
-  const auto uEmissiveTexture = glGetUniformLocation(glslProgram.glId(), "uEmissiveTexture");
-  const auto uOcclusionTexture = glGetUniformLocation(glslProgram.glId(), "uOcclusionTexture");
-  const auto uOcclusionStrength = glGetUniformLocation(glslProgram.glId(), "uOcclusionStrength");
-  const auto uApplyOcclusion = glGetUniformLocation(glslProgram.glId(), "uApplyOcclusion");
-
-  tinygltf::Model model;
-
-  if (!loadGltfFile(model))
+  const SceneResources resources{scene, profiler};
+  SceneRenderer renderer{resources, m_ShadersRootPath / m_vertexShader, m_ShadersRootPath / m_fragmentShader, m_MultiDrawIndirect, profiler};
+  if (m_ReleaseCpuData && !(offscreenJobs && offscreenJobs->sharedScene))
   {
-    return -1;
+    scene.releaseUploadedData();
   }
 
-  glm::vec3 bboxMin, bboxMax;
-  computeSceneBounds(model, bboxMin, bboxMax);
-
-  auto up = glm::vec3(0, 1, 0);
-  auto center = (bboxMin + bboxMax) * 0.5f;
-  auto diag = bboxMax - bboxMin;
-
-  // Build projection matrix
-  auto maxDistance = glm::length(diag);
-
-  maxDistance = maxDistance > 0.f ? maxDistance : 100.f;
-  const auto projMatrix = glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight, 0.001f * maxDistance, 1.5f * maxDistance);
-
-  // TODO Implement a new CameraController model and use it instead. Propose
-  // the choice from the GUI
-  std::unique_ptr<CameraController> cameraController =
-      std::make_unique<TrackballCameraController>(m_GLFWHandle.window(), 0.25f * maxDistance);
+  const auto maxDistance = renderer.maxDistance();
+  auto projMatrix = renderer.getProjectionMatrix(float(m_nWindowWidth) / m_nWindowHeight);
 
-  if (m_hasUserCamera)
+  if (offscreenJobs)
   {
-    cameraController->setCamera(m_userCamera);
-  } else
-  {
-    auto eye = diag.z > 0 ? diag : center + 2.f * glm::cross(diag, up);
-    cameraController->setCamera(Camera{diag, center, up});
+    // Offscreen frames are read back bottom row first: render them upside
+    // down so that images are written without flipping their rows. Nothing is
+    // culled, so the inverted winding does not matter.
+    projMatrix = glm::scale(glm::mat4(1), glm::vec3(1, -1, 1)) * projMatrix;
   }
 
-  glm::vec3 lightingDirection(1, 1, 1);
-  glm::vec3 lightingIntensity(1, 1, 1);
-  bool lightFromCamera = false;
-  bool applyOcclusion = true;
-
-  auto textureObjects = createTextureObjects(model);
-
-  GLuint whiteTexture = 0;
-
-  glGenTextures(1, &whiteTexture);
-  glBindTexture(GL_TEXTURE_2D, whiteTexture);
-  float white[] = {1, 1, 1, 1};
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, white);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  SceneRenderer::Lighting lighting;
+  const auto drawScene = [&](const Camera &camera) { renderer.draw(camera, projMatrix, m_nWindowWidth, m_nWindowHeight, lighting); };
 
-  auto modelBufferObjects = createBufferObjects(model);
-
-  std::vector<VaoRange> meshindexToVaoRange;
-  const auto vertexArrayObjects = createVertexArrayObjects(model, modelBufferObjects, meshindexToVaoRange);
-
-  // Setup OpenGL state for rendering
-  glEnable(GL_DEPTH_TEST);
-  glslProgram.use();
-
-  const auto bindMaterial = [&](const auto materialIndex) {
-    // Material binding
-    if (materialIndex >= 0)
+  if (offscreenJobs && isTiled())
+  {
+    if (m_RenderAovs)
     {
-      const auto &material = model.materials[materialIndex];
-      const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
-
-      if (uBaseColorFactor >= 0)
-      {
-        glUniform4f(uBaseColorFactor, (float)pbrMetallicRoughness.baseColorFactor[0], (float)pbrMetallicRoughness.baseColorFactor[1],
-            (float)pbrMetallicRoughness.baseColorFactor[2], (float)pbrMetallicRoughness.baseColorFactor[3]);
-      }
-
-      if (uMetallicFactor >= 0)
-      {
-        glUniform1f(uMetallicFactor, (float)pbrMetallicRoughness.metallicFactor);
-      }
-
-      if (uRoughnessFactor >= 0)
-      {
-        glUniform1f(uRoughnessFactor, (float)pbrMetallicRoughness.roughnessFactor);
-      }
-
-      if (uEmissiveFactor >= 0)
-      {
-        glUniform3f(
-            uEmissiveFactor, (float)material.emissiveFactor[0], (float)material.emissiveFactor[1], (float)material.emissiveFactor[2]);
-      }
-
-      if (uOcclusionStrength >= 0)
-      {
-        glUniform1f(uOcclusionStrength, (float)material.occlusionTexture.strength);
-      }
-
-      if (uBaseColorTexture >= 0)
-      {
-        auto textureObject = whiteTexture;
-        if (pbrMetallicRoughness.baseColorTexture.index >= 0)
-        {
-          const auto &texture = model.textures[pbrMetallicRoughness.baseColorTexture.index];
-
-          if (texture.source >= 0)
-          {
-            textureObject = textureObjects[texture.source];
-          }
-        }
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(uBaseColorTexture, 0);
-      }
-
-      if (uMetallicRoughnessTexture >= 0)
-      {
-        auto metallicRoughnessObject = 0u;
-        if (pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
-        {
-          const auto &metallicRoughness = model.textures[pbrMetallicRoughness.metallicRoughnessTexture.index];
-          if (metallicRoughness.source >= 0)
-          {
-            metallicRoughnessObject = textureObjects[metallicRoughness.source];
-          }
-          glActiveTexture(GL_TEXTURE1);
-          glBindTexture(GL_TEXTURE_2D, metallicRoughnessObject);
-          glUniform1i(uMetallicRoughnessTexture, 1);
-        }
-      }
-
-      if (uEmissiveTexture >= 0)
-      {
-        auto emissiveObject = 0u;
-        if (material.emissiveTexture.index >= 0)
-        {
-          const auto &texture = model.textures[material.emissiveTexture.index];
-          if (texture.source >= 0)
-          {
-            emissiveObject = textureObjects[texture.source];
-          }
-        }
-
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, emissiveObject);
-        glUniform1i(uEmissiveTexture, 2);
-      }
-
-      if (uOcclusionTexture >= 0)
-      {
-        auto occlusionObject = whiteTexture;
-        if (material.occlusionTexture.index >= 0)
-        {
-          const auto &texture = model.textures[material.occlusionTexture.index];
-          if (texture.source >= 0)
-          {
-            occlusionObject = textureObjects[texture.source];
-          }
-        }
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, occlusionObject);
-        glUniform1i(uOcclusionTexture, 3);
-      }
-
-    } else
+      std::cerr << "Warn : arbitrary output variables are not rendered tile by tile" << std::endl;
+    }
+    const auto &jobs = offscreenJobs->jobs;
+    auto returnCode = 0;
+    auto firstImage = true;
+    profiler.beginPhase("first_frame");
+    for (auto jobIdx = offscreenJobs->nextJob++; jobIdx < jobs.size(); jobIdx = offscreenJobs->nextJob++)
     {
-      if (uBaseColorFactor >= 0)
-      {
-        glUniform4f(uBaseColorFactor, 1, 1, 1, 1);
-      }
-
-      if (uMetallicFactor >= 0)
+      if (!renderTiledImage(renderer, lighting, jobs[jobIdx].camera, jobs[jobIdx].outputPath))
       {
-        glUniform1f(uMetallicFactor, 1.f);
+        returnCode = -1;
       }
-
-      if (uRoughnessFactor >= 0)
-      {
-        glUniform1f(uRoughnessFactor, 1.f);
-      }
-
-      if (uEmissiveFactor >= 0)
+      if (firstImage)
       {
-        glUniform3f(uEmissiveFactor, 0.f, 0.f, 0.f);
+        firstImage = false;
+        profiler.endPhase();
+        writeStartupProfile(profiler);
       }
+    }
+    return returnCode;
+  }
 
-      if (uOcclusionStrength >= 0)
+  if (offscreenJobs)
+  {
+    // Three stages run concurrently: the GPU renders frame k + 1 while frame k
+    // is read back, and images are encoded by a pool of threads. Encoding is
+    // throttled so that pixels waiting for it stay bounded.
+    const size_t READBACK_RING_SIZE = 3;
+    const auto &jobs = offscreenJobs->jobs;
+    auto &encoder = *offscreenJobs->encoder;
+    auto returnCode = 0;
+    const auto maxPendingEncodes = 2 * encoder.threadCount();
+    std::deque<std::future<bool>> pendingEncodes;
+    const auto waitOldestEncode = [&]() {
+      if (!pendingEncodes.front().get())
       {
-        glUniform1f(uOcclusionStrength, 0.f);
+        returnCode = -1;
       }
+      pendingEncodes.pop_front();
+    };
 
-      if (uBaseColorTexture >= 0)
-      {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(uBaseColorTexture, 0);
-      }
+    // Index in jobs of each frame rendered by this context
+    std::vector<size_t> frameJobs;
 
-      if (uMetallicRoughnessTexture >= 0)
+    profiler.beginPhase("first_frame");
+    {
+      const auto pixelType = GLenum(isFloatImageFormat(m_ImageWriterOptions.format) ? GL_FLOAT : GL_UNSIGNED_BYTE);
+      // Arbitrary output variables are read back with the color, in the order
+      // of the outputs of pbr_directional_light.fs.glsl
+      std::vector<FrameReadback::Attachment> attachments = {
+          {GLenum(pixelType == GL_FLOAT ? GL_RGBA32F : GL_RGBA8), GL_RGB, pixelType}};
+      if (m_RenderAovs)
       {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(uMetallicRoughnessTexture, 1);
+        attachments.push_back({GL_R32F, GL_RED, GL_FLOAT});     // Linear depth
+        attachments.push_back({GL_RGBA32F, GL_RGB, GL_FLOAT}); // View space normal
+        attachments.push_back({GL_RGBA32F, GL_RGB, GL_FLOAT}); // Object ids
       }
-
-      if (uEmissiveTexture >= 0)
+      FrameReadback readback{m_nWindowWidth, m_nWindowHeight, attachments, READBACK_RING_SIZE,
+          [&](size_t frameIdx, std::vector<unsigned char> &&pixels) {
+            if (frameIdx == 0)
+            {
+              profiler.endPhase(pixels.size());
+              writeStartupProfile(profiler);
+            }
+            const auto strPath = jobs[frameJobs[frameIdx]].outputPath.string();
+            if (pixels.empty())
+            {
+              std::cerr << "Error : unable to read back " << strPath << std::endl;
+              returnCode = -1;
+              return;
+            }
+            if (pendingEncodes.size() >= maxPendingEncodes)
+            {
+              waitOldestEncode();
+            }
+            const auto width = m_nWindowWidth;
+            const auto height = m_nWindowHeight;
+            const auto &options = m_ImageWriterOptions;
+            const auto renderAovs = m_RenderAovs;
+            const auto depthOffset = renderAovs ? readback.attachmentOffset(1) : 0;
+            const auto normalsOffset = renderAovs ? readback.attachmentOffset(2) : 0;
+            const auto objectIdsOffset = renderAovs ? readback.attachmentOffset(3) : 0;
+            pendingEncodes.push_back(encoder.push([strPath, width, height, &options, renderAovs, depthOffset, normalsOffset,
+                                                      objectIdsOffset, pixels = std::move(pixels)]() {
+              TRACE_ZONE("encodeImage");
+              std::string err;
+              if (!writeImage(strPath, width, height, pixels.data(), options, err))
+              {
+                std::cerr << "Error : " << err << std::endl;
+                return false;
+              }
+              if (renderAovs)
+              {
+                const auto depth = pixels.data() + depthOffset;
+                const auto normals = pixels.data() + normalsOffset;
+                const auto objectIds = pixels.data() + objectIdsOffset;
+                if (!writeFloatImage(getAovPath(strPath, "depth"), width, height, 1, depth, err) ||
+                    !writeFloatImage(getAovPath(strPath, "normal"), width, height, 3, normals, err) ||
+                    !writeFloatImage(getAovPath(strPath, "ids"), width, height, 3, objectIds, err))
+                {
+                  std::cerr << "Error : " << err << std::endl;
+                  return false;
+                }
+              }
+              return true;
+            }));
+          }};
+
+      // GPU time of rendering and readback is measured with the startup
+      // profile
+      GpuProfiler gpuProfiler;
+      gpuProfiler.setEnabled(profiler.enabled());
+      readback.setGpuProfiler(&gpuProfiler);
+
+      // Jobs are pulled one by one, so that contexts rendering concurrently
+      // stay balanced
+      for (auto jobIdx = offscreenJobs->nextJob++; jobIdx < jobs.size(); jobIdx = offscreenJobs->nextJob++)
       {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(uEmissiveTexture, 2);
+        frameJobs.push_back(jobIdx);
+        gpuProfiler.beginFrame();
+        readback.render([&]() {
+          ScopedGpuTimer timer{&gpuProfiler, "scene"};
+          drawScene(jobs[jobIdx].camera);
+        });
+        gpuProfiler.endFrame();
       }
+      readback.flush();
 
-      if (uOcclusionTexture >= 0)
+      // Frames are read FRAME_LATENCY frames late, the last ones are not
+      const auto &sceneHistory = gpuProfiler.history("scene");
+      const auto &readbackHistory = gpuProfiler.history("readback");
+      if (!sceneHistory.empty() && !readbackHistory.empty())
       {
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(uOcclusionTexture, 3);
+        std::clog << "GPU ms per frame (median of the last " << sceneHistory.size() << " frames): scene "
+                  << summarize(sceneHistory)["median"] << ", readback " << summarize(readbackHistory)["median"] << std::endl;
       }
     }
-  };
-
-  // Lambda function to draw the scene
-  const auto drawScene = [&](const Camera &camera) {
-    glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    const auto viewMatrix = camera.getViewMatrix();
-
-    if (lightingDirectionLocation >= 0)
-    {
-      const auto lightDirectionInViewSpace =
-          lightFromCamera ? glm::vec3(0, 0, 1) : glm::normalize(glm::vec3(viewMatrix * glm::vec4(lightingDirection, 0.)));
-      glUniform3f(lightingDirectionLocation, lightDirectionInViewSpace[0], lightDirectionInViewSpace[1], lightDirectionInViewSpace[2]);
-    }
 
-    if (lightingIntensityLocation >= 0)
+    while (!pendingEncodes.empty())
     {
-      glUniform3f(lightingIntensityLocation, lightingIntensity[0], lightingIntensity[1], lightingIntensity[2]);
+      waitOldestEncode();
     }
 
-    if (uApplyOcclusion >= 0)
-    {
-      glUniform1i(uApplyOcclusion, applyOcclusion);
-    }
-
-    // The recursive function that should draw a node
-    // We use a std::function because a simple lambda cannot be recursive
-    const std::function<void(int, const glm::mat4 &)> drawNode = [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-      // TODO The drawNode function
-      const auto &node = model.nodes[nodeIdx];
-      glm::mat4 modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
-      if (node.mesh >= 0)
-      {
-        const glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
-
-        const glm::mat4 modelViewProjectionMatrix = projMatrix * modelViewMatrix;
-
-        const glm::mat4 normalMatrix = glm::transpose(glm::inverse(modelViewMatrix));
-
-        glUniformMatrix4fv(modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewMatrix));
-        glUniformMatrix4fv(modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewProjectionMatrix));
-        glUniformMatrix4fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    return returnCode;
+  }
 
-        const auto &mesh = model.meshes[node.mesh];
-        const auto &vaoRange = meshindexToVaoRange[node.mesh];
-        for (int primIdx = 0; primIdx < mesh.primitives.size(); primIdx++)
-        {
-          const auto vao = vertexArrayObjects[vaoRange.begin + primIdx];
+  // TODO Implement a new CameraController model and use it instead. Propose
+  // the choice from the GUI
+  std::unique_ptr<CameraController> cameraController =
+      std::make_unique<TrackballCameraController>(m_GLFWHandle.window(), 0.25f * maxDistance);
+  cameraController->setCamera(getInitialCamera(scene));
 
-          const auto &primitive = mesh.primitives[primIdx];
+  GpuProfiler gpuProfiler;
+  renderer.setGpuProfiler(&gpuProfiler);
+  std::vector<float> cpuSubmitHistory; // Milliseconds spent in drawScene()
 
-          bindMaterial(primitive.material);
+  // Loop until the user closes the window
+  for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
+  {
+    TRACE_ZONE("frame");
+    const auto seconds = glfwGetTime();
 
-          glBindVertexArray(vao);
+    if (iterationCount == 0)
+    {
+      profiler.beginPhase("first_frame");
+    }
 
-          if (primitive.indices >= 0)
-          {
-            const auto &accessor = model.accessors[primitive.indices];
-            const auto &bufferView = model.bufferViews[accessor.bufferView];
-            const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
-            glDrawElements(primitive.mode, accessor.count, accessor.componentType, (const GLvoid *)byteOffset);
-          } else
-          {
-            const auto accessorIdx = (*begin(primitive.attributes)).second;
-            const auto &accessor = model.accessors[accessorIdx];
-            glDrawArrays(primitive.mode, 0, GLsizei(accessor.count));
-          }
-        }
-      }
-      for (const auto child : node.children)
-      {
-        drawNode(child, modelMatrix);
-      }
-    };
+    gpuProfiler.beginFrame();
 
-    // Draw the scene referenced by gltf file
-    if (model.defaultScene >= 0)
+    const auto camera = cameraController->getCamera();
+    scene.sceneGraph.updateWorldMatrices();
     {
-      for (auto node : model.scenes[model.defaultScene].nodes)
+      ScopedGpuTimer timer{&gpuProfiler, "scene"};
+      const auto submitStart = glfwGetTime();
+      drawScene(camera);
+      if (cpuSubmitHistory.size() == GpuProfiler::HISTORY_SIZE)
       {
-        drawNode(node, glm::mat4(1));
+        cpuSubmitHistory.erase(begin(cpuSubmitHistory));
       }
+      cpuSubmitHistory.push_back(float((glfwGetTime() - submitStart) * 1000.));
     }
-  };
-
-  if (!m_OutputPath.empty())
-  {
-    std::vector<unsigned char> pixels(m_nWindowHeight * m_nWindowWidth * 3);
-    renderToImage(m_nWindowWidth, m_nWindowHeight, 3, pixels.data(), [&]() { drawScene(cameraController->getCamera()); });
-    flipImageYAxis(m_nWindowWidth, m_nWindowHeight, 3, pixels.data());
-    const auto strPath = m_OutputPath.string();
-    stbi_write_png(strPath.c_str(), m_nWindowWidth, m_nWindowHeight, 3, pixels.data(), 0);
-
-    return 0;
-  }
-
-  // Loop until the user closes the window
-  for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
-  {
-    const auto seconds = glfwGetTime();
-
-    const auto camera = cameraController->getCamera();
-    drawScene(camera);
 
     // GUI code:
     imguiNewFrame();
 
     {
+      TRACE_ZONE("buildGui");
       ImGui::Begin("GUI");
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
       if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen))
@@ -606,23 +408,30 @@ int ViewerApplication::run()
                                   ImGui::SliderFloat("phi angle", &phi, 0.0f, 2. * glm::pi<float>());
         if (lightChanged)
         {
-          lightingDirection = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+          lighting.direction = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
         }
         static glm::vec3 color{1.0f, 1.0f, 1.0f};
         static float factor = 1.f;
         const auto colorChanged = ImGui::ColorEdit3("light color", (float *)&color) || ImGui::InputFloat("light factor", &factor);
         if (colorChanged)
         {
-          lightingIntensity = color * factor;
+          lighting.intensity = color * factor;
         }
-        ImGui::Checkbox("light from camera", &lightFromCamera);
-        ImGui::Checkbox("Ambient occlusion", &applyOcclusion);
+        ImGui::Checkbox("light from camera", &lighting.fromCamera);
+        ImGui::Checkbox("Ambient occlusion", &lighting.applyOcclusion);
       }
 
       ImGui::End();
     }
 
-    imguiRenderFrame();
+    drawProfilerPanel(gpuProfiler, cpuSubmitHistory, renderer.lastDrawStats());
+
+    {
+      TRACE_ZONE("renderGui");
+      ScopedGpuTimer timer{&gpuProfiler, "imgui"};
+      imguiRenderFrame();
+    }
+    gpuProfiler.endFrame();
 
     glfwPollEvents(); // Poll for and process events
 
@@ -633,7 +442,17 @@ int ViewerApplication::run()
       cameraController->update(float(ellapsedTime));
     }
 
-    m_GLFWHandle.swapBuffers(); // Swap front and back buffers
+    {
+      TRACE_ZONE("swapBuffers");
+      m_GLFWHandle.swapBuffers(); // Swap front and back buffers
+    }
+
+    if (iterationCount == 0 && profiler.enabled())
+    {
+      glFinish(); // Wait for the first frame to be actually rendered
+      profiler.endPhase();
+      writeStartupProfile(profiler);
+    }
   }
 
   // TODO clean up allocated GL data
@@ -641,38 +460,264 @@ int ViewerApplication::run()
   return 0;
 }
 
-ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height, const fs::path &gltfFile,
-    const std::vector<float> &lookatArgs, const std::string &vertexShader, const std::string &fragmentShader, const fs::path &output) :
-    m_nWindowWidth(width),
-    m_nWindowHeight(height),
+ViewerApplication::ViewerApplication(const fs::path &appPath, const Options &options) :
+    m_nWindowWidth(options.width),
+    m_nWindowHeight(options.height),
     m_AppPath{appPath},
     m_AppName{m_AppPath.stem().string()},
     m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
     m_ShadersRootPath{m_AppPath.parent_path() / "shaders"},
-    m_gltfFilePath{gltfFile},
-    m_OutputPath{output}
+    m_gltfFilePath{options.gltfFile},
+    m_OutputPath{options.outputPath},
+    m_CamerasPath{options.camerasPath},
+    m_ImageWriterOptions{options.imageWriterOptions},
+    m_HasImageFormat{options.hasImageFormat},
+    m_EncodeThreadCount{options.encodeThreadCount},
+    m_RenderWorkerCount{options.renderWorkerCount},
+    m_nTileSize{GLsizei(options.tileSize)},
+    m_RenderAovs{options.renderAovs},
+    m_CacheDirectory{options.cacheDirectory},
+    m_MultiDrawIndirect{options.multiDrawIndirect},
+    m_ReleaseCpuData{options.releaseCpuData},
+    m_StartupProfiler{options.profileStartupPath, "context_creation"}
 {
-  if (!lookatArgs.empty())
+  m_StartupProfiler.endPhase();
+
+  const auto &lookat = options.lookat;
+  if (!lookat.empty())
   {
     m_hasUserCamera = true;
-    m_userCamera = Camera{glm::vec3(lookatArgs[0], lookatArgs[1], lookatArgs[2]), glm::vec3(lookatArgs[3], lookatArgs[4], lookatArgs[5]),
-        glm::vec3(lookatArgs[6], lookatArgs[7], lookatArgs[8])};
+    m_userCamera = Camera{
+        glm::vec3(lookat[0], lookat[1], lookat[2]), glm::vec3(lookat[3], lookat[4], lookat[5]), glm::vec3(lookat[6], lookat[7], lookat[8])};
   }
 
-  if (!vertexShader.empty())
+  if (!options.vertexShader.empty())
+  {
+    m_vertexShader = options.vertexShader;
+  } else if (m_MultiDrawIndirect)
   {
-    m_vertexShader = vertexShader;
+    m_vertexShader = "forward_indirect.vs.glsl";
   }
 
-  if (!fragmentShader.empty())
+  if (!options.fragmentShader.empty())
   {
-    m_fragmentShader = fragmentShader;
+    m_fragmentShader = options.fragmentShader;
   }
 
   ImGui::GetIO().IniFilename = m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows
                                                            // positions in this file
 
-  glfwSetKeyCallback(m_GLFWHandle.window(), keyCallback);
+  if (m_GLFWHandle.window())
+  {
+    glfwSetKeyCallback(m_GLFWHandle.window(), keyCallback);
+  }
 
   printGLVersion();
 }
+
+void ViewerApplication::drawProfilerPanel(
+    GpuProfiler &gpuProfiler, const std::vector<float> &cpuSubmitHistory, const SceneRenderer::DrawStats &drawStats) const
+{
+  ImGui::Begin("Profiler");
+
+  static bool gpuTimers = false;
+  static bool drawScopes = false;
+  if (ImGui::Checkbox("GPU timers", &gpuTimers))
+  {
+    gpuProfiler.setEnabled(gpuTimers);
+  }
+  ImGui::SameLine();
+  if (ImGui::Checkbox("Per draw timers", &drawScopes))
+  {
+    gpuProfiler.setDrawScopesEnabled(drawScopes);
+  }
+
+  ImGui::Text("%u draw calls, %llu triangles, %u state changes", drawStats.drawCalls, (unsigned long long)drawStats.triangles,
+      drawStats.stateChanges);
+
+  // CPU submission next to GPU time of the scene tells whether a slow frame
+  // is limited by the CPU or by the GPU
+  const auto plotHistory = [](const char *label, const std::vector<float> &history) {
+    if (history.empty())
+    {
+      return;
+    }
+    char overlay[32];
+    std::snprintf(overlay, sizeof(overlay), "%.3f ms", history.back());
+    ImGui::PlotLines(label, history.data(), int(history.size()), 0, overlay, 0.f, FLT_MAX, ImVec2(0, 50));
+  };
+  plotHistory("CPU scene", cpuSubmitHistory);
+  plotHistory("GPU scene", gpuProfiler.history("scene"));
+  plotHistory("GPU imgui", gpuProfiler.history("imgui"));
+
+  if (gpuProfiler.drawScopesEnabled() && ImGui::CollapsingHeader("Most expensive draws", ImGuiTreeNodeFlags_DefaultOpen))
+  {
+    static bool sortByName = false;
+    std::vector<const GpuProfiler::ScopeTiming *> draws;
+    for (const auto &timing : gpuProfiler.timings())
+    {
+      if (timing.depth > 0)
+      {
+        draws.push_back(&timing);
+      }
+    }
+    std::sort(begin(draws), end(draws), [](const GpuProfiler::ScopeTiming *lhs, const GpuProfiler::ScopeTiming *rhs) {
+      return sortByName ? lhs->name < rhs->name : lhs->milliseconds > rhs->milliseconds;
+    });
+
+    // Clicking a header sorts by its column
+    ImGui::Columns(2, "draws");
+    if (ImGui::Selectable("GPU ms", !sortByName))
+    {
+      sortByName = false;
+    }
+    ImGui::NextColumn();
+    if (ImGui::Selectable("Draw", sortByName))
+    {
+      sortByName = true;
+    }
+    ImGui::NextColumn();
+    ImGui::Separator();
+    const size_t MAX_DRAW_COUNT = 100;
+    for (size_t i = 0; i < std::min(draws.size(), MAX_DRAW_COUNT); ++i)
+    {
+      ImGui::Text("%.4f", draws[i]->milliseconds);
+      ImGui::NextColumn();
+      ImGui::TextUnformatted(draws[i]->name.c_str());
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+  }
+
+  ImGui::End();
+}
+
+bool ViewerApplication::resolveImageFormat(const std::vector<CameraJob> &jobs, std::string &err)
+{
+  auto resolved = m_HasImageFormat;
+  for (const auto &job : jobs)
+  {
+    ImageFormat pathFormat;
+    if (!getImageFormat(job.outputPath, pathFormat))
+    {
+      continue;
+    }
+    if (!resolved)
+    {
+      m_ImageWriterOptions.format = pathFormat;
+      resolved = true;
+    } else if (pathFormat != m_ImageWriterOptions.format)
+    {
+      err = m_HasImageFormat ? "the extension of " + job.outputPath.string() + " does not match --format"
+                             : "output paths have different formats, " + job.outputPath.string() + " is the first one differing";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ViewerApplication::isTiled() const
+{
+  if (m_nTileSize > 0)
+  {
+    return m_nWindowWidth > m_nTileSize || m_nWindowHeight > m_nTileSize;
+  }
+  return m_nWindowWidth > maxFramebufferSize() || m_nWindowHeight > maxFramebufferSize();
+}
+
+GLsizei ViewerApplication::maxFramebufferSize() const
+{
+  GLint maxTextureSize = 0;
+  GLint maxViewportDims[2] = {0, 0};
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+  return std::min({maxTextureSize, maxViewportDims[0], maxViewportDims[1]});
+}
+
+bool ViewerApplication::renderTiledImage(
+    SceneRenderer &renderer, const SceneRenderer::Lighting &lighting, const Camera &camera, const fs::path &outputPath) const
+{
+  TRACE_ZONE("renderTiledImage");
+  const size_t READBACK_RING_SIZE = 3;
+  const GLsizei DEFAULT_TILE_SIZE = 1024;
+  const auto tileSize = std::min(m_nTileSize > 0 ? m_nTileSize : DEFAULT_TILE_SIZE, maxFramebufferSize());
+  const auto width = m_nWindowWidth;
+  const auto height = m_nWindowHeight;
+  const auto tileColumns = (width + tileSize - 1) / tileSize;
+  const auto tileRows = (height + tileSize - 1) / tileSize;
+  const auto pixelType = GLenum(isFloatImageFormat(m_ImageWriterOptions.format) ? GL_FLOAT : GL_UNSIGNED_BYTE);
+  const auto pixelSize = size_t(3) * (pixelType == GL_FLOAT ? sizeof(float) : 1);
+
+  std::string err;
+  StreamingImageWriter writer;
+  if (!writer.open(outputPath, width, height, m_ImageWriterOptions, err))
+  {
+    std::cerr << "Error : " << err << std::endl;
+    return false;
+  }
+
+  // Tiles of a row are gathered in a band, written once its last tile is read
+  // back: memory is proportional to a row of tiles, not to the image
+  std::vector<unsigned char> band(size_t(width) * tileSize * pixelSize);
+  auto ok = true;
+  FrameReadback readback{tileSize, tileSize, pixelType, READBACK_RING_SIZE, [&](size_t tileIdx, std::vector<unsigned char> &&pixels) {
+                           if (!ok)
+                           {
+                             return;
+                           }
+                           if (pixels.empty())
+                           {
+                             err = "unable to read back a tile of " + outputPath.string();
+                             ok = false;
+                             return;
+                           }
+                           const auto column = GLsizei(tileIdx % tileColumns);
+                           const auto x = column * tileSize;
+                           const auto y = GLsizei(tileIdx / tileColumns) * tileSize;
+                           const auto copySize = std::min(tileSize, width - x) * pixelSize;
+                           const auto bandHeight = std::min(tileSize, height - y);
+                           for (GLsizei row = 0; row < bandHeight; ++row)
+                           {
+                             std::memcpy(band.data() + (size_t(row) * width + x) * pixelSize,
+                                 pixels.data() + size_t(row) * tileSize * pixelSize, copySize);
+                           }
+                           if (column == tileColumns - 1)
+                           {
+                             TRACE_ZONE("writeBand");
+                             ok = writer.writeRows(band.data(), bandHeight, err);
+                           }
+                         }};
+
+  // Each tile is rendered with the projection of the whole image, followed by
+  // the transform of the tile area in normalized device coordinates to
+  // [-1, 1]. Tiles on the right and bottom edges extend past the image.
+  const auto projMatrix = renderer.getProjectionMatrix(float(width) / height);
+  const auto flipMatrix = glm::scale(glm::mat4(1), glm::vec3(1, -1, 1)); // See renderScene()
+  const auto scale = glm::vec3(float(width) / tileSize, float(height) / tileSize, 1);
+  for (GLsizei row = 0; row < tileRows && ok; ++row)
+  {
+    for (GLsizei column = 0; column < tileColumns; ++column)
+    {
+      // Center of the tile, y pointing up
+      const auto center = glm::vec2((column + 0.5f) * tileSize / width * 2 - 1, 1 - (row + 0.5f) * tileSize / height * 2);
+      const auto tileMatrix = glm::scale(glm::mat4(1), scale) * glm::translate(glm::mat4(1), glm::vec3(-center, 0));
+      readback.render([&]() { renderer.draw(camera, flipMatrix * tileMatrix * projMatrix, tileSize, tileSize, lighting); });
+    }
+  }
+  readback.flush();
+
+  if (!ok || !writer.close(err))
+  {
+    std::cerr << "Error : " << err << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void ViewerApplication::writeStartupProfile(const StartupProfiler &profiler) const
+{
+  if (!profiler.write())
+  {
+    std::cerr << "Unable to write startup profile" << std::endl;
+  }
+}
\ No newline at end of file
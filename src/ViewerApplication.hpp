@@ -1,25 +1,55 @@
 #pragma once
 
+#include "SceneRenderer.hpp"
 #include "utils/GLFWHandle.hpp"
+#include "utils/camera_batch.hpp"
 #include "utils/cameras.hpp"
 #include "utils/filesystem.hpp"
-#include "utils/shaders.hpp"
-#include <tiny_gltf.h>
+#include "utils/image_writer.hpp"
+#include "utils/startup_profiler.hpp"
+#include "utils/thread_pool.hpp"
+
+#include <atomic>
 
 class ViewerApplication
 {
 public:
-  ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height, const fs::path &gltfFile,
-      const std::vector<float> &lookatArgs, const std::string &vertexShader, const std::string &fragmentShader, const fs::path &output);
+  // Options of the viewer command, see the members of ViewerApplication for
+  // their meaning
+  struct Options
+  {
+    fs::path gltfFile;
+    std::vector<float> lookat; // The 9 numbers of --lookat, default camera if empty
+    std::string vertexShader;  // Default shaders if empty
+    std::string fragmentShader;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    fs::path outputPath;
+    fs::path camerasPath;
+    ImageWriterOptions imageWriterOptions;
+    bool hasImageFormat = false; // imageWriterOptions.format was set by --format
+    size_t encodeThreadCount = 0;
+    size_t renderWorkerCount = 1;
+    uint32_t tileSize = 0;
+    bool renderAovs = false;
+    fs::path cacheDirectory;
+    fs::path profileStartupPath; // Startup is not profiled if empty
+    bool multiDrawIndirect = false;
+    bool releaseCpuData = false;
+  };
+
+  ViewerApplication(const fs::path &appPath, const Options &options);
 
   int run();
 
 private:
-  // A range of indices in a vector containing Vertex Array Objects
-  struct VaoRange
+  // Offscreen renders, pulled in order by the render contexts
+  struct OffscreenJobs
   {
-    GLsizei begin; // Index of first element in vertexArrayObjects
-    GLsizei count; // Number of elements in range
+    std::vector<CameraJob> jobs;
+    std::atomic<size_t> nextJob{0};
+    ThreadPool *encoder = nullptr; // Shared by all render contexts
+    bool sharedScene = false;      // Rendered by several contexts
   };
 
   GLsizei m_nWindowWidth = 1280;
@@ -37,12 +67,38 @@ private:
   Camera m_userCamera;
 
   fs::path m_OutputPath;
+  fs::path m_CamerasPath; // Batch of camera poses to render, see loadCameraJobs()
+  ImageWriterOptions m_ImageWriterOptions;
+  // If false, the format of m_ImageWriterOptions is replaced by that of the
+  // extension of output paths, see resolveImageFormat()
+  bool m_HasImageFormat = false;
+  size_t m_EncodeThreadCount = 0; // One encoding thread per hardware thread if 0
+  size_t m_RenderWorkerCount = 1; // Threads rendering offscreen, each with its own context
+  // Offscreen images larger than this are rendered tile by tile. If 0, only
+  // those larger than the maximum framebuffer size are, see isTiled().
+  GLsizei m_nTileSize = 0;
+  // Write linear depth, normals and object ids of offscreen renders next to
+  // each image, as <name>.depth.pfm, <name>.normal.pfm and <name>.ids.pfm
+  bool m_RenderAovs = false;
+
+  fs::path m_CacheDirectory; // Scene cache is disabled if empty
+
+  // Draw the scene with glMultiDrawElementsIndirect instead of one draw call
+  // per primitive
+  bool m_MultiDrawIndirect = false;
+
+  // Free the CPU copies of images and buffers once the scene is uploaded, see
+  // LoadedScene::releaseUploadedData()
+  bool m_ReleaseCpuData = false;
 
   // Order is important here, see comment below
   const std::string m_ImGuiIniFilename;
+  // Starts profiling the creation of m_GLFWHandle, so it must be declared
+  // right before it
+  StartupProfiler m_StartupProfiler;
   // Last to be initialized, first to be destroyed:
-  GLFWHandle m_GLFWHandle{
-      int(m_nWindowWidth), int(m_nWindowHeight), "glTF Viewer", m_OutputPath.empty()}; // show the window only if m_OutputPath is empty
+  GLFWHandle m_GLFWHandle{int(m_nWindowWidth), int(m_nWindowHeight), "glTF Viewer",
+      m_OutputPath.empty() && m_CamerasPath.empty()}; // show the window only if not rendering offscreen
                                                                                        /*
                                                                                          ! THE ORDER OF DECLARATION OF MEMBER VARIABLES IS IMPORTANT !
                                                                                          - m_ImGuiIniFilename.c_str() will be used by ImGUI in ImGui::Shutdown, which
@@ -54,9 +110,29 @@ private:
                                                                                          the creation of a GLFW windows and thus a GL context which must exists
                                                                                          before most of OpenGL function calls.
                                                                                        */
-  bool loadGltfFile(tinygltf::Model &model);
-  std::vector<GLuint> createBufferObjects(const tinygltf::Model &model) const;
-  std::vector<GLuint> createVertexArrayObjects(
-      const tinygltf::Model &model, const std::vector<GLuint> &bufferObjects, std::vector<VaoRange> &meshindexToVaoRange) const;
-  std::vector<GLuint> createTextureObjects(const tinygltf::Model &model) const;
+  Camera getInitialCamera(const LoadedScene &scene) const;
+  // Create GPU objects of the scene in the current context, then render the
+  // offscreen jobs if offscreenJobs is not null, or run the interactive viewer.
+  // Offscreen, it can be called by several threads at once, each with its own
+  // context.
+  int renderScene(LoadedScene &scene, StartupProfiler &profiler, OffscreenJobs *offscreenJobs);
+  void writeStartupProfile(const StartupProfiler &profiler) const;
+  // "Profiler" window of the viewer: CPU and GPU time graphs, and the most
+  // expensive draws when per draw timers are enabled
+  void drawProfilerPanel(
+      GpuProfiler &gpuProfiler, const std::vector<float> &cpuSubmitHistory, const SceneRenderer::DrawStats &drawStats) const;
+
+  // Format of offscreen images: the one of the extension of output paths
+  // unless it is given. Return false and set err if output paths have
+  // different formats, or if one conflicts with the given format. Paths with
+  // other extensions are written in the resolved format.
+  bool resolveImageFormat(const std::vector<CameraJob> &jobs, std::string &err);
+
+  bool isTiled() const;
+  // Largest framebuffer the current context can render to
+  GLsizei maxFramebufferSize() const;
+  // Render an offscreen image tile by tile in a single tile sized framebuffer,
+  // and write it band by band. Return false on error.
+  bool renderTiledImage(
+      SceneRenderer &renderer, const SceneRenderer::Lighting &lighting, const Camera &camera, const fs::path &outputPath) const;
 };
\ No newline at end of file
@@ -1,12 +1,27 @@
+#include "FrameBenchmark.hpp"
+#include "RenderServer.hpp"
 #include "ViewerApplication.hpp"
 #include "utils/GLFWHandle.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/image_writer.hpp"
+#include "utils/scene_generator.hpp"
+#include "utils/tracing.hpp"
 
 #include <args.hxx>
 
 std::vector<std::string> split(
     const std::string &str, const std::string &delim);
 
+// Start tracing if a --trace file is specified, see traceFlagHelp
+void startTrace(const std::string &tracePath);
+// Write the trace started by startTrace(tracePath), if any
+void finishTrace(const std::string &tracePath);
+
+const char *const traceFlagHelp =
+    "Record CPU zones (scene loading, GPU object creation, draws, readback, "
+    "encoding, ...) of all threads and write them in a Chrome trace file, "
+    "to open with chrome://tracing or Perfetto";
+
 int main(int argc, char **argv)
 {
   auto returnCode = 0;
@@ -41,11 +56,73 @@ int main(int argc, char **argv)
             {"h", "height"}};
         args::ValueFlag<std::string> output{parser, "output",
             "Output path to render the image. If specified no window is shown. "
-            "Only png is supported.",
+            "The file format is given by the extension, or by --format.",
             {"o", "output"}};
+        args::ValueFlag<std::string> cameras{parser, "cameras",
+            "File of camera poses to render offscreen, one per line, either "
+            "as CSV (the 9 --lookat numbers followed by the output path) or "
+            "as JSON ({\"lookat\": [...], \"output\": \"path\"}). The model "
+            "is loaded once for all poses. If specified no window is shown.",
+            {"cameras"}};
+        args::ValueFlag<std::string> format{parser, "format",
+            "Format of offscreen renders: png, jpg, ppm, pfm or hdr. Default "
+            "is the format of the extension of output paths, png if it is "
+            "none of these. pfm and hdr are written from a float render "
+            "target.",
+            {"format"}};
+        args::ValueFlag<int> pngCompression{parser, "level",
+            "PNG compression level, from 0 (fastest) to 9 (default 8)",
+            {"png-compression"}};
+        args::ValueFlag<int> jpegQuality{parser, "quality",
+            "JPEG quality, from 1 to 100 (default 90)", {"jpeg-quality"}};
+        args::ValueFlag<uint32_t> encodeThreads{parser, "count",
+            "Number of threads encoding offscreen renders (default one per "
+            "hardware thread)",
+            {"encode-threads"}};
+        args::ValueFlag<uint32_t> renderWorkers{parser, "count",
+            "Number of threads rendering offscreen, each with its own "
+            "headless context and GPU objects (default 1). Needs a build "
+            "with GLTF_VIEWER_USE_EGL.",
+            {"render-workers"}};
+        args::ValueFlag<uint32_t> tileSize{parser, "size",
+            "Render offscreen images larger than size x size tile by tile, "
+            "and write them band by band (png, ppm or pfm). Images larger "
+            "than the maximum framebuffer size are always rendered in tiles "
+            "of 1024 x 1024.",
+            {"tile-size"}};
+        args::Flag aovs{parser, "aov",
+            "With offscreen renders, also write linear depth, view space "
+            "normals and node/primitive/material ids (indices + 1, 0 for the "
+            "background) of each image in <name>.depth.pfm, "
+            "<name>.normal.pfm and <name>.ids.pfm, from the same render. "
+            "The fragment shader must write them, as "
+            "pbr_directional_light.fs.glsl does.",
+            {"aov"}};
+        args::ValueFlag<std::string> cacheDirectory{parser, "cache-dir",
+            "Directory of the scene cache. If specified, the loaded scene is "
+            "cached there and later runs on the same file load it from the "
+            "cache.",
+            {"cache-dir"}};
+        args::ValueFlag<std::string> profileStartup{parser, "file.json",
+            "Write wall time, CPU time and bytes processed by each startup "
+            "phase (until the first frame) in a JSON file. Offscreen renders "
+            "also print the GPU time of drawing and reading back frames.",
+            {"profile-startup"}};
+        args::Flag multiDrawIndirect{parser, "multi-draw-indirect",
+            "Draw the scene with glMultiDrawElementsIndirect instead of one "
+            "draw call per primitive. The default vertex shader becomes "
+            "forward_indirect.vs.glsl.",
+            {"multi-draw-indirect"}};
+        args::Flag releaseCpuData{parser, "release-cpu-data",
+            "Free the CPU copies of images and buffers once the scene is "
+            "uploaded to the GPU. Not applied with several render workers.",
+            {"release-cpu-data"}};
+        args::ValueFlag<std::string> trace{
+            parser, "file.json", traceFlagHelp, {"trace"}};
         parser.Parse();
 
-        std::vector<float> lookatParams;
+        ViewerApplication::Options options;
+        options.gltfFile = args::get(file);
         if (lookat) {
           const std::string &lookatArgs = args::get(lookat);
           const auto tokens = split(lookatArgs, ",");
@@ -55,17 +132,214 @@ int main(int argc, char **argv)
                                         std::to_string(tokens.size()) + ")");
           }
           for (const auto &arg : tokens) {
-            lookatParams.emplace_back(std::stof(arg));
+            options.lookat.emplace_back(std::stof(arg));
           }
         }
+        options.vertexShader = args::get(vertexShader);
+        options.fragmentShader = args::get(fragmentShader);
+        if (imageWidth) {
+          options.width = args::get(imageWidth);
+        }
+        if (imageHeight) {
+          options.height = args::get(imageHeight);
+        }
+        options.outputPath = args::get(output);
+        options.camerasPath = args::get(cameras);
 
-        uint32_t width = imageWidth ? args::get(imageWidth) : 1280;
-        uint32_t height = imageHeight ? args::get(imageHeight) : 720;
+        auto &imageWriterOptions = options.imageWriterOptions;
+        if (format &&
+            !parseImageFormat(args::get(format), imageWriterOptions.format)) {
+          throw args::ValidationError(
+              "Unknown --format argument " + args::get(format));
+        }
+        options.hasImageFormat = format;
+        if (pngCompression) {
+          imageWriterOptions.pngCompressionLevel =
+              std::min(std::max(args::get(pngCompression), 0), 9);
+        }
+        if (jpegQuality) {
+          imageWriterOptions.jpegQuality =
+              std::min(std::max(args::get(jpegQuality), 1), 100);
+        }
 
-        ViewerApplication app{fs::path{argv[0]}, width, height, args::get(file),
-            lookatParams, args::get(vertexShader), args::get(fragmentShader),
-            args::get(output)};
+        options.encodeThreadCount = args::get(encodeThreads);
+        if (renderWorkers) {
+          options.renderWorkerCount = args::get(renderWorkers);
+        }
+        options.tileSize = args::get(tileSize);
+        options.renderAovs = aovs;
+        options.cacheDirectory = args::get(cacheDirectory);
+        options.profileStartupPath = args::get(profileStartup);
+        options.multiDrawIndirect = multiDrawIndirect;
+        options.releaseCpuData = releaseCpuData;
+
+        startTrace(args::get(trace));
+        ViewerApplication app{fs::path{argv[0]}, options};
         returnCode = app.run();
+        finishTrace(args::get(trace));
+      }};
+  args::Command bench{commands, "bench",
+      "Measure frame times of a model rendered offscreen along a camera path",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> file{
+            parser, "file", "Path to file", args::Options::Required};
+        args::ValueFlag<std::string> cameras{parser, "cameras",
+            "Camera path to play back, in the format of the viewer --cameras "
+            "option without output paths. Default is one turn around the "
+            "model.",
+            {"cameras"}};
+        args::ValueFlag<uint32_t> frames{parser, "count",
+            "Number of measured frames (default 300)", {"frames"}};
+        args::ValueFlag<uint32_t> warmup{parser, "count",
+            "Number of frames rendered before measuring (default 10)",
+            {"warmup"}};
+        args::ValueFlag<int32_t> imageWidth{
+            parser, "width", "Width of rendered frames", {"w", "width"}};
+        args::ValueFlag<int32_t> imageHeight{
+            parser, "height", "Height of rendered frames", {"h", "height"}};
+        args::ValueFlag<std::string> vertexShader{
+            parser, "vs", "Vertex shader to use", {"vs"}};
+        args::ValueFlag<std::string> fragmentShader{
+            parser, "fs", "Fragment shader to use", {"fs"}};
+        args::ValueFlag<std::string> output{parser, "file.json",
+            "Write the JSON report in a file instead of stdout",
+            {"o", "output"}};
+        args::ValueFlag<std::string> cacheDirectory{parser, "cache-dir",
+            "Directory of the scene cache, see the viewer command",
+            {"cache-dir"}};
+        args::Flag multiDrawIndirect{parser, "multi-draw-indirect",
+            "Draw with glMultiDrawElementsIndirect, see the viewer command",
+            {"multi-draw-indirect"}};
+        args::ValueFlag<std::string> trace{
+            parser, "file.json", traceFlagHelp, {"trace"}};
+        parser.Parse();
+
+        FrameBenchmark::Options options;
+        options.gltfFile = args::get(file);
+        options.camerasPath = args::get(cameras);
+        options.outputPath = args::get(output);
+        options.cacheDirectory = args::get(cacheDirectory);
+        options.vertexShader = args::get(vertexShader);
+        options.fragmentShader = args::get(fragmentShader);
+        if (imageWidth) {
+          options.width = std::max(args::get(imageWidth), 1);
+        }
+        if (imageHeight) {
+          options.height = std::max(args::get(imageHeight), 1);
+        }
+        if (frames) {
+          options.frameCount = args::get(frames);
+        }
+        if (warmup) {
+          options.warmupFrameCount = args::get(warmup);
+        }
+        options.multiDrawIndirect = multiDrawIndirect;
+
+        startTrace(args::get(trace));
+        FrameBenchmark benchmark{fs::path{argv[0]}, options};
+        returnCode = benchmark.run();
+        finishTrace(args::get(trace));
+      }};
+  args::Command serve{commands, "serve",
+      "Render requests read as lines of JSON from stdin or a socket, keeping "
+      "recently used models loaded",
+      [&](args::Subparser &parser) {
+        args::ValueFlag<std::string> socket{parser, "path",
+            "Listen on a Unix domain socket created at path instead of "
+            "reading stdin",
+            {"socket"}};
+        args::ValueFlag<uint64_t> cacheBudget{parser, "MiB",
+            "Memory budget of loaded models and their GPU objects, least "
+            "recently used models are released beyond it (default 1024)",
+            {"cache-budget"}};
+        args::ValueFlag<std::string> cacheDirectory{parser, "cache-dir",
+            "Directory of the scene cache, see the viewer command",
+            {"cache-dir"}};
+        args::Flag releaseCpuData{parser, "release-cpu-data",
+            "Free the CPU copies of images and buffers of loaded models once "
+            "uploaded to the GPU, so that more models fit in the cache budget",
+            {"release-cpu-data"}};
+        args::ValueFlag<std::string> trace{
+            parser, "file.json", traceFlagHelp, {"trace"}};
+        parser.Parse();
+
+        startTrace(args::get(trace));
+        RenderServer server{fs::path{argv[0]}, args::get(cacheDirectory),
+            (cacheBudget ? args::get(cacheBudget) : 1024) * 1024 * 1024,
+            releaseCpuData};
+        returnCode = socket ? server.serveSocket(args::get(socket))
+                            : server.serveStdin();
+        finishTrace(args::get(trace));
+      }};
+
+  args::Command generate{commands, "generate",
+      "Write a synthetic scene to stress the viewer, generated "
+      "deterministically from a seed",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> file{parser, "file",
+            "Path of the .gltf (with a .bin file next to it) or .glb file "
+            "to write",
+            args::Options::Required};
+        args::ValueFlag<uint32_t> nodes{
+            parser, "count", "Number of nodes (default 1000)", {"nodes"}};
+        args::ValueFlag<uint32_t> depth{parser, "levels",
+            "Levels of the node hierarchy, 1 for a flat scene (default 4)",
+            {"depth"}};
+        args::ValueFlag<uint32_t> instancesPerMesh{parser, "count",
+            "Number of nodes sharing each mesh (default 4)",
+            {"instances-per-mesh"}};
+        args::ValueFlag<uint32_t> triangles{parser, "count",
+            "Approximate number of triangles per mesh (default 5000)",
+            {"triangles"}};
+        args::ValueFlag<uint32_t> materials{parser, "count",
+            "Number of materials, 0 for the default material (default 16)",
+            {"materials"}};
+        args::ValueFlag<uint32_t> textures{parser, "count",
+            "Number of base color textures, shared round robin by "
+            "materials (default 8)",
+            {"textures"}};
+        args::ValueFlag<uint32_t> textureSize{parser, "size",
+            "Width and height of textures (default 512)", {"texture-size"}};
+        args::ValueFlag<uint32_t> indexWidth{parser, "bits",
+            "Bits per index: 8, 16 or 32 (default 32)", {"index-width"}};
+        args::ValueFlag<uint32_t> seed{
+            parser, "seed", "Random seed (default 1)", {"seed"}};
+        parser.Parse();
+
+        SceneGeneratorOptions options;
+        if (nodes) {
+          options.nodeCount = args::get(nodes);
+        }
+        if (depth) {
+          options.depth = args::get(depth);
+        }
+        if (instancesPerMesh) {
+          options.instancesPerMesh = args::get(instancesPerMesh);
+        }
+        if (triangles) {
+          options.trianglesPerMesh = args::get(triangles);
+        }
+        if (materials) {
+          options.materialCount = args::get(materials);
+        }
+        if (textures) {
+          options.textureCount = args::get(textures);
+        }
+        if (textureSize) {
+          options.textureSize = args::get(textureSize);
+        }
+        if (indexWidth) {
+          options.indexWidth = args::get(indexWidth);
+        }
+        if (seed) {
+          options.seed = args::get(seed);
+        }
+
+        std::string err;
+        if (!generateScene(args::get(file), options, err)) {
+          std::cerr << "Error : " << err << std::endl;
+          returnCode = -1;
+        }
       }};
 
   try {
@@ -107,4 +381,16 @@ std::vector<std::string> split(const std::string &str, const std::string &delim)
     prev = pos + delim.length();
   } while (pos < str.length() && prev < str.length());
   return tokens;
-}
\ No newline at end of file
+}
+void startTrace(const std::string &tracePath)
+{
+  if (!tracePath.empty())
+    startTracing();
+}
+
+void finishTrace(const std::string &tracePath)
+{
+  std::string err;
+  if (!tracePath.empty() && !writeTrace(fs::path{tracePath}, err))
+    std::cerr << "Error : " << err << std::endl;
+}
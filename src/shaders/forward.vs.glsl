@@ -7,15 +7,19 @@ layout(location = 2) in vec2 aTexCoords;
 out vec3 vViewSpacePosition;
 out vec3 vViewSpaceNormal;
 out vec2 vTexCoords;
+flat out uvec3 vObjectIds;
 
 uniform mat4 uModelViewProjMatrix;
 uniform mat4 uModelViewMatrix;
 uniform mat4 uNormalMatrix;
+// Node, primitive and material of the draw, see pbr_directional_light.fs.glsl
+uniform uvec3 uObjectIds;
 
 void main()
 {
     vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1));
 	vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(aNormal, 0)));
 	vTexCoords = aTexCoords;
+	vObjectIds = uObjectIds;
     gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
 }
\ No newline at end of file
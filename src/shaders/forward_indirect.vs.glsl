@@ -0,0 +1,39 @@
+#version 430
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+// Index of the draw in the multi draw call, taken from the baseInstance of
+// the indirect command since gl_DrawID requires GL 4.6
+layout(location = 3) in uint aDrawId;
+
+out vec3 vViewSpacePosition;
+out vec3 vViewSpaceNormal;
+out vec2 vTexCoords;
+flat out uvec3 vObjectIds;
+
+struct DrawTransform
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uvec4 objectIds; // Node, primitive and material, see forward.vs.glsl
+};
+
+layout(std430, binding = 0) readonly buffer DrawTransforms
+{
+    DrawTransform uDrawTransforms[];
+};
+
+uniform mat4 uViewMatrix;
+uniform mat4 uProjMatrix;
+
+void main()
+{
+    DrawTransform transform = uDrawTransforms[aDrawId];
+    vec4 viewSpacePosition = uViewMatrix * transform.modelMatrix * vec4(aPosition, 1);
+    vViewSpacePosition = vec3(viewSpacePosition);
+    vViewSpaceNormal = normalize(mat3(uViewMatrix) * mat3(transform.normalMatrix) * aNormal);
+    vTexCoords = aTexCoords;
+    vObjectIds = transform.objectIds.xyz;
+    gl_Position = uProjMatrix * viewSpacePosition;
+}
@@ -3,15 +3,19 @@
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
 in vec2 vTexCoords;
+flat in uvec3 vObjectIds;
 
 uniform vec3 uLightDirection;
 uniform vec3 uLightIntensity;
 
-uniform vec4 uBaseColorFactor;
-uniform float uMetallicFactor;
-uniform float uRoughnessFactor;
-uniform vec3 uEmissiveFactor; 
-uniform float uOcclusionStrength;
+layout(std140) uniform Material
+{
+  vec4 uBaseColorFactor;
+  vec3 uEmissiveFactor;
+  float uMetallicFactor;
+  float uRoughnessFactor;
+  float uOcclusionStrength;
+};
 
 uniform sampler2D uBaseColorTexture;
 uniform sampler2D uMetallicRoughnessTexture;
@@ -20,7 +24,13 @@ uniform sampler2D uOcclusionTexture;
 
 uniform int uApplyOcclusion;
 
-out vec3 fColor;
+layout(location = 0) out vec3 fColor;
+// Arbitrary output variables, only kept when the framebuffer has attachments
+// for them: distance to the camera plane, view space normal, and indices + 1
+// of node, primitive and material (0 for the default material)
+layout(location = 1) out float fLinearDepth;
+layout(location = 2) out vec3 fViewSpaceNormal;
+layout(location = 3) out vec3 fObjectIds;
 
 const float GAMMA = 2.2;
 const float INV_GAMMA = 1. / GAMMA;
@@ -99,4 +109,7 @@ void main()
   }
 
   fColor = LINEARtoSRGB(color);
+  fLinearDepth = -vViewSpacePosition.z;
+  fViewSpaceNormal = N;
+  fObjectIds = vec3(vObjectIds);
 }
\ No newline at end of file
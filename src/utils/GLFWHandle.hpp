@@ -1,5 +1,6 @@
 #pragma once
 
+#include "egl_context.hpp"
 #include "gl_debug_output.hpp"
 #include "glfw.hpp"
 #include <glm/glm.hpp>
@@ -9,15 +10,41 @@
 #include <imgui_impl_opengl3.h>
 
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
 // Class responsible for initializing GLFW, creating a window, initializing
-// OpenGL function pointers with GLAD library and initializing ImGUI
+// OpenGL function pointers with GLAD library and initializing ImGUI.
+// When built with GLTF_VIEWER_USE_EGL, a handle that is not visible creates a
+// headless EGL context instead, so that no window system is needed: it has no
+// window and ImGui is only usable for its settings.
 class GLFWHandle
 {
 public:
   GLFWHandle(int width, int height, const char *title, bool visible = true)
   {
+#ifdef GLTF_VIEWER_USE_EGL
+    if (!visible) {
+      try {
+#ifdef NDEBUG
+        const auto debugContext = false;
+#else
+        const auto debugContext = true;
+#endif
+        m_pHeadlessContext =
+            std::make_unique<EGLContextHandle>(4, 4, debugContext);
+      } catch (const std::runtime_error &) {
+        std::cerr << "Falling back to a hidden GLFW window.\n";
+      }
+    }
+
+    if (m_pHeadlessContext) {
+      initGLDebugOutput();
+      ImGui::CreateContext();
+      return;
+    }
+#endif
+
     if (!glfwInit()) {
       std::cerr << "Unable to init GLFW.\n";
       throw std::runtime_error("Unable to init GLFW.\n");
@@ -32,7 +59,11 @@ public:
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    if (visible) {
+      // Offscreen rendering goes to framebuffer objects, the default one is
+      // only multisampled when it is displayed
+      glfwWindowHint(GLFW_SAMPLES, 4);
+    }
 
     m_pWindow =
         glfwCreateWindow(int(width), int(height), title, nullptr, nullptr);
@@ -62,6 +93,11 @@ public:
 
   ~GLFWHandle()
   {
+    if (!m_pWindow) {
+      ImGui::DestroyContext();
+      return; // Headless context
+    }
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -85,10 +121,27 @@ public:
 
   void swapBuffers() const { glfwSwapBuffers(m_pWindow); }
 
+  // Make the context current in the calling thread, e.g. after it has been
+  // used by other threads
+  void makeContextCurrent() const
+  {
+#ifdef GLTF_VIEWER_USE_EGL
+    if (m_pHeadlessContext) {
+      m_pHeadlessContext->makeCurrent();
+      return;
+    }
+#endif
+    glfwMakeContextCurrent(m_pWindow);
+  }
+
+  // nullptr for a headless context
   GLFWwindow *window() { return m_pWindow; }
 
 private:
   GLFWwindow *m_pWindow = nullptr;
+#ifdef GLTF_VIEWER_USE_EGL
+  std::unique_ptr<EGLContextHandle> m_pHeadlessContext;
+#endif
 };
 
 inline void imguiNewFrame()
@@ -0,0 +1,131 @@
+#include "camera_batch.hpp"
+
+#include <json.hpp>
+
+#include <array>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+bool makeCameraJob(const std::array<float, 9> &lookat, const std::string &output, bool requireOutput, CameraJob &job)
+{
+  const glm::vec3 eye{lookat[0], lookat[1], lookat[2]};
+  const glm::vec3 center{lookat[3], lookat[4], lookat[5]};
+  const glm::vec3 up{lookat[6], lookat[7], lookat[8]};
+  if ((requireOutput && output.empty()) || glm::cross(up, center - eye) == glm::vec3(0))
+  {
+    return false;
+  }
+  job = {Camera{eye, center, up}, output};
+  return true;
+}
+
+bool parseJsonLine(const std::string &line, bool requireOutput, CameraJob &job)
+{
+  const auto object = nlohmann::json::parse(line, nullptr, false);
+  if (!object.is_object() || object.count("lookat") == 0 || (requireOutput && object.count("output") == 0))
+  {
+    return false;
+  }
+  const auto &lookatArray = object["lookat"];
+  const auto output = object.count("output") ? object["output"] : nlohmann::json{""};
+  if (!lookatArray.is_array() || lookatArray.size() != 9 || !output.is_string())
+  {
+    return false;
+  }
+  std::array<float, 9> lookat;
+  for (size_t i = 0; i < lookat.size(); ++i)
+  {
+    if (!lookatArray[i].is_number())
+    {
+      return false;
+    }
+    lookat[i] = lookatArray[i].get<float>();
+  }
+  return makeCameraJob(lookat, output.get<std::string>(), requireOutput, job);
+}
+
+bool parseCsvLine(const std::string &line, bool requireOutput, CameraJob &job)
+{
+  std::istringstream stream{line};
+  std::array<float, 9> lookat;
+  for (auto &value : lookat)
+  {
+    std::string token;
+    if (!std::getline(stream, token, ','))
+    {
+      return false;
+    }
+    try
+    {
+      size_t parsedLength = 0;
+      value = std::stof(token, &parsedLength);
+      if (token.find_first_not_of(" \t", parsedLength) != std::string::npos)
+      {
+        return false;
+      }
+    } catch (const std::logic_error &)
+    {
+      return false;
+    }
+  }
+  // The output path is the rest of the line, it may contain commas
+  std::string output;
+  std::getline(stream, output);
+  const auto first = output.find_first_not_of(" \t");
+  const auto last = output.find_last_not_of(" \t\r");
+  output = first == std::string::npos ? std::string{} : output.substr(first, last - first + 1);
+  return makeCameraJob(lookat, output, requireOutput, job);
+}
+
+bool loadCameraFile(const fs::path &path, bool requireOutput, std::vector<CameraJob> &jobs, std::string &err)
+{
+  std::ifstream input{path.string()};
+  if (!input)
+  {
+    err = "unable to open " + path.string();
+    return false;
+  }
+
+  std::string line;
+  for (size_t lineNumber = 1; std::getline(input, line); ++lineNumber)
+  {
+    const auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+    {
+      continue;
+    }
+
+    CameraJob job;
+    const auto valid = line[first] == '{' ? parseJsonLine(line, requireOutput, job) : parseCsvLine(line, requireOutput, job);
+    if (!valid)
+    {
+      err = path.string() + ":" + std::to_string(lineNumber) + ": invalid camera pose";
+      return false;
+    }
+    jobs.push_back(std::move(job));
+  }
+  return true;
+}
+
+} // namespace
+
+bool loadCameraJobs(const fs::path &path, std::vector<CameraJob> &jobs, std::string &err)
+{
+  return loadCameraFile(path, true, jobs, err);
+}
+
+bool loadCameraPath(const fs::path &path, std::vector<Camera> &cameras, std::string &err)
+{
+  std::vector<CameraJob> jobs;
+  if (!loadCameraFile(path, false, jobs, err))
+  {
+    return false;
+  }
+  for (const auto &job : jobs)
+  {
+    cameras.push_back(job.camera);
+  }
+  return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "cameras.hpp"
+#include "filesystem.hpp"
+
+#include <string>
+#include <vector>
+
+// A camera pose to render and the path of the image to write
+struct CameraJob
+{
+  Camera camera;
+  fs::path outputPath;
+};
+
+// Read the camera poses of a batch file, one per line. A line is either CSV:
+//   eye_x,eye_y,eye_z,center_x,center_y,center_z,up_x,up_y,up_z,output_path
+// or a JSON object:
+//   {"lookat": [eye_x, ..., up_z], "output": "output_path"}
+// Empty lines and lines starting with '#' are ignored. Return false and set
+// err if the file cannot be read or a line is invalid.
+bool loadCameraJobs(const fs::path &path, std::vector<CameraJob> &jobs, std::string &err);
+
+// Read a camera path in the same format, in which output paths are optional
+// and ignored
+bool loadCameraPath(const fs::path &path, std::vector<Camera> &cameras, std::string &err);
@@ -0,0 +1,218 @@
+#include "deflate.hpp"
+
+#include <algorithm>
+
+namespace {
+
+const int WINDOW_SIZE = 32768; // Maximum distance of a match
+const int MAX_MATCH_LENGTH = 258;
+const int HASH_SIZE = 1 << 15;
+const std::size_t MAX_STORED_BLOCK_SIZE = 65535;
+
+const int LENGTH_BASES[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int LENGTH_EXTRA_BITS[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int DISTANCE_BASES[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+    6145, 8193, 12289, 16385, 24577};
+const int DISTANCE_EXTRA_BITS[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Huffman codes are packed starting from their most significant bit
+uint32_t reverseBits(uint32_t code, int count)
+{
+  uint32_t reversed = 0;
+  for (int i = 0; i < count; ++i, code >>= 1)
+  {
+    reversed = (reversed << 1) | (code & 1);
+  }
+  return reversed;
+}
+
+int hash3(const unsigned char *data)
+{
+  return ((data[0] << 10) ^ (data[1] << 5) ^ data[2]) & (HASH_SIZE - 1);
+}
+
+// Index of the last base not greater than value
+template <size_t N> int findBase(const int (&bases)[N], int value)
+{
+  return int(std::upper_bound(bases, bases + N, value) - bases) - 1;
+}
+
+} // namespace
+
+ZlibStream::ZlibStream(int level) : m_nMaxChainLength(level <= 0 ? 0 : 1 << (std::min(level, 9) - 1))
+{
+  // 32K window, no preset dictionary, default compression
+  m_Output.push_back(0x78);
+  m_Output.push_back(0x01);
+}
+
+void ZlibStream::write(const unsigned char *data, std::size_t size)
+{
+  if (m_bFinished || size == 0)
+  {
+    return;
+  }
+
+  // Adler-32 of uncompressed data, sums are reduced before they can overflow
+  for (std::size_t offset = 0; offset < size;)
+  {
+    const auto end = std::min(size, offset + 5552);
+    for (; offset < end; ++offset)
+    {
+      m_nAdlerA += data[offset];
+      m_nAdlerB += m_nAdlerA;
+    }
+    m_nAdlerA %= 65521;
+    m_nAdlerB %= 65521;
+  }
+
+  if (m_nMaxChainLength == 0)
+  {
+    writeStored(data, size);
+    return;
+  }
+
+  writeBits(0, 1); // BFINAL
+  writeBits(1, 2); // BTYPE, fixed Huffman codes
+
+  // Chains link positions whose next 3 bytes have the same hash, most recent
+  // first. Only the last WINDOW_SIZE positions are linked, positions of
+  // overwritten links are checked by comparing bytes.
+  const auto hashPosition = [&](int64_t position) {
+    if (position + 3 <= int64_t(size))
+    {
+      auto &head = m_HashHeads[hash3(data + position)];
+      m_HashChains[position & (WINDOW_SIZE - 1)] = head;
+      head = position;
+    }
+  };
+  m_HashHeads.assign(HASH_SIZE, -1);
+  m_HashChains.resize(WINDOW_SIZE);
+
+  for (int64_t position = 0; position < int64_t(size);)
+  {
+    const auto maxLength = int(std::min<int64_t>(MAX_MATCH_LENGTH, int64_t(size) - position));
+    auto bestLength = 0;
+    auto bestDistance = 0;
+    if (maxLength >= 3)
+    {
+      auto candidate = m_HashHeads[hash3(data + position)];
+      for (auto chainLength = m_nMaxChainLength; candidate >= 0 && position - candidate <= WINDOW_SIZE && chainLength > 0; --chainLength)
+      {
+        if (data[candidate + bestLength] == data[position + bestLength])
+        {
+          auto length = 0;
+          while (length < maxLength && data[candidate + length] == data[position + length])
+          {
+            ++length;
+          }
+          if (length > bestLength)
+          {
+            bestLength = length;
+            bestDistance = int(position - candidate);
+            if (length == maxLength)
+            {
+              break;
+            }
+          }
+        }
+        const auto next = m_HashChains[candidate & (WINDOW_SIZE - 1)];
+        if (next >= candidate)
+        {
+          break; // Link overwritten by a more recent position
+        }
+        candidate = next;
+      }
+    }
+
+    if (bestLength >= 3)
+    {
+      writeMatch(bestLength, bestDistance);
+      for (const auto end = position + bestLength; position < end; ++position)
+      {
+        hashPosition(position);
+      }
+    } else
+    {
+      hashPosition(position);
+      writeSymbol(data[position]);
+      ++position;
+    }
+  }
+
+  writeSymbol(256); // End of block
+}
+
+void ZlibStream::finish()
+{
+  if (m_bFinished)
+  {
+    return;
+  }
+  m_bFinished = true;
+
+  // Empty final block, then the checksum on a byte boundary
+  writeBits(1, 1);
+  writeBits(1, 2);
+  writeSymbol(256);
+  writeBits(0, (8 - m_nBitCount) % 8);
+  m_Output.push_back((unsigned char)(m_nAdlerB >> 8));
+  m_Output.push_back((unsigned char)m_nAdlerB);
+  m_Output.push_back((unsigned char)(m_nAdlerA >> 8));
+  m_Output.push_back((unsigned char)m_nAdlerA);
+}
+
+void ZlibStream::writeStored(const unsigned char *data, std::size_t size)
+{
+  for (std::size_t offset = 0; offset < size; offset += MAX_STORED_BLOCK_SIZE)
+  {
+    const auto length = uint32_t(std::min(MAX_STORED_BLOCK_SIZE, size - offset));
+    writeBits(0, 1); // BFINAL
+    writeBits(0, 2); // BTYPE, no compression
+    writeBits(0, (8 - m_nBitCount) % 8);
+    writeBits(length, 16);
+    writeBits(~length & 0xFFFF, 16);
+    // Aligned on a byte boundary, the bit buffer is empty
+    m_Output.insert(end(m_Output), data + offset, data + offset + length);
+  }
+}
+
+void ZlibStream::writeBits(uint32_t bits, int count)
+{
+  m_BitBuffer |= uint64_t(bits) << m_nBitCount;
+  m_nBitCount += count;
+  while (m_nBitCount >= 8)
+  {
+    m_Output.push_back((unsigned char)m_BitBuffer);
+    m_BitBuffer >>= 8;
+    m_nBitCount -= 8;
+  }
+}
+
+void ZlibStream::writeSymbol(int symbol)
+{
+  if (symbol < 144)
+  {
+    writeBits(reverseBits(0x30 + symbol, 8), 8);
+  } else if (symbol < 256)
+  {
+    writeBits(reverseBits(0x190 + symbol - 144, 9), 9);
+  } else if (symbol < 280)
+  {
+    writeBits(reverseBits(symbol - 256, 7), 7);
+  } else
+  {
+    writeBits(reverseBits(0xC0 + symbol - 280, 8), 8);
+  }
+}
+
+void ZlibStream::writeMatch(int length, int distance)
+{
+  const auto lengthCode = findBase(LENGTH_BASES, length);
+  writeSymbol(257 + lengthCode);
+  writeBits(length - LENGTH_BASES[lengthCode], LENGTH_EXTRA_BITS[lengthCode]);
+
+  const auto distanceCode = findBase(DISTANCE_BASES, distance);
+  writeBits(reverseBits(distanceCode, 5), 5);
+  writeBits(distance - DISTANCE_BASES[distanceCode], DISTANCE_EXTRA_BITS[distanceCode]);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Incremental zlib (RFC 1950) encoder: data is compressed as it is written,
+// each write() becoming a deflate block with the fixed Huffman codes, so that
+// large outputs never need to be held in memory. Matches are searched in the
+// data of the same write() call only. At level 0, data is written in stored
+// blocks without compression.
+class ZlibStream
+{
+public:
+  // level from 0 (stored, fastest) to 9 (longest match search)
+  explicit ZlibStream(int level = 8);
+
+  void write(const unsigned char *data, std::size_t size);
+
+  // Terminate the stream, after which nothing can be written
+  void finish();
+
+  // Compressed bytes produced so far and not yet taken. The last partial byte
+  // is kept until the next write() or finish().
+  std::vector<unsigned char> &output() { return m_Output; }
+
+private:
+  void writeStored(const unsigned char *data, std::size_t size); // Level 0
+  void writeBits(uint32_t bits, int count);
+  void writeSymbol(int symbol); // Literal or length code
+  void writeMatch(int length, int distance);
+
+  const int m_nMaxChainLength;
+  std::vector<unsigned char> m_Output;
+  uint64_t m_BitBuffer = 0;
+  int m_nBitCount = 0;
+  uint32_t m_nAdlerA = 1;
+  uint32_t m_nAdlerB = 0;
+  bool m_bFinished = false;
+
+  // Hash chains of the current write() call, see write()
+  std::vector<int64_t> m_HashHeads;
+  std::vector<int64_t> m_HashChains;
+};
@@ -0,0 +1,193 @@
+#ifdef GLTF_VIEWER_USE_EGL
+
+#include "egl_context.hpp"
+
+// Avoid X11 headers and their macros (None, Bool...)
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+
+// clang-format off
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+// clang-format on
+
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+bool hasExtension(const char *extensions, const char *name)
+{
+  if (!extensions)
+  {
+    return false;
+  }
+  const auto nameLength = std::strlen(name);
+  for (auto *it = std::strstr(extensions, name); it; it = std::strstr(it + nameLength, name))
+  {
+    const auto end = it[nameLength];
+    if ((it == extensions || it[-1] == ' ') && (end == ' ' || end == '\0'))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Prefer displays that need no window system: Mesa surfaceless platform,
+// then the first EGL device (e.g. NVIDIA without X server), then the default
+// display
+EGLDisplay getHeadlessDisplay()
+{
+  const auto *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  const auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+  if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+  {
+    const auto display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY)
+    {
+      return display;
+    }
+  }
+
+  const auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+  if (getPlatformDisplay && queryDevices && hasExtension(clientExtensions, "EGL_EXT_platform_device"))
+  {
+    EGLDeviceEXT device;
+    EGLint deviceCount = 0;
+    if (queryDevices(1, &device, &deviceCount) && deviceCount > 0)
+    {
+      const auto display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+      if (display != EGL_NO_DISPLAY)
+      {
+        return display;
+      }
+    }
+  }
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+// The display is shared by all contexts, it is only terminated with the last
+// one
+std::mutex s_DisplayMutex;
+int s_DisplayRefCount = 0;
+
+} // namespace
+
+EGLContextHandle::EGLContextHandle(int majorVersion, int minorVersion, bool debug)
+{
+  const auto fail = [this](const std::string &message) {
+    std::cerr << message << "\n";
+    release();
+    throw std::runtime_error(message);
+  };
+
+  const auto display = getHeadlessDisplay();
+  {
+    std::lock_guard<std::mutex> lock{s_DisplayMutex};
+    EGLint eglMajor = 0, eglMinor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor))
+    {
+      fail("Unable to init EGL.");
+    }
+    m_Display = display;
+    ++s_DisplayRefCount;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API))
+  {
+    fail("EGL does not support OpenGL.");
+  }
+
+  const auto surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+  // Color and depth are irrelevant: rendering goes to framebuffer objects
+  const EGLint configAttribs[] = {
+      EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+  {
+    fail("Unable to find an EGL config.");
+  }
+
+  if (!surfaceless)
+  {
+    const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    m_Surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    if (m_Surface == EGL_NO_SURFACE)
+    {
+      fail("Unable to create an EGL pbuffer.");
+    }
+  }
+
+  const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, majorVersion, EGL_CONTEXT_MINOR_VERSION, minorVersion,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+      EGL_NONE};
+  m_Context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+  if (m_Context == EGL_NO_CONTEXT)
+  {
+    fail("Unable to create an EGL context.");
+  }
+
+  const auto surface = m_Surface ? EGLSurface(m_Surface) : EGL_NO_SURFACE;
+  if (!eglMakeCurrent(display, surface, surface, EGLContext(m_Context)))
+  {
+    fail("Unable to make the EGL context current.");
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+  {
+    fail("Unable to init OpenGL.");
+  }
+}
+
+void EGLContextHandle::makeCurrent() const
+{
+  const auto surface = m_Surface ? EGLSurface(m_Surface) : EGL_NO_SURFACE;
+  eglMakeCurrent(EGLDisplay(m_Display), surface, surface, EGLContext(m_Context));
+}
+
+void EGLContextHandle::releaseCurrent() const
+{
+  eglMakeCurrent(EGLDisplay(m_Display), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+EGLContextHandle::~EGLContextHandle()
+{
+  release();
+}
+
+void EGLContextHandle::release()
+{
+  if (!m_Display)
+  {
+    return;
+  }
+  if (eglGetCurrentContext() == EGLContext(m_Context))
+  {
+    releaseCurrent();
+  }
+  if (m_Context)
+  {
+    eglDestroyContext(EGLDisplay(m_Display), EGLContext(m_Context));
+  }
+  if (m_Surface)
+  {
+    eglDestroySurface(EGLDisplay(m_Display), EGLSurface(m_Surface));
+  }
+  std::lock_guard<std::mutex> lock{s_DisplayMutex};
+  if (--s_DisplayRefCount == 0)
+  {
+    eglTerminate(EGLDisplay(m_Display));
+  }
+  m_Display = m_Surface = m_Context = nullptr;
+}
+
+#endif
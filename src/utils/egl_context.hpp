@@ -0,0 +1,39 @@
+#pragma once
+
+#ifdef GLTF_VIEWER_USE_EGL
+
+// Headless OpenGL context created with EGL, without any window system: a
+// surfaceless context when the driver supports it (e.g. Mesa llvmpipe),
+// bound to a 1x1 pbuffer otherwise. Rendering must target framebuffer
+// objects.
+class EGLContextHandle
+{
+public:
+  // Create a core profile context of the given version, make it current and
+  // load OpenGL function pointers with GLAD. Throw std::runtime_error on
+  // failure.
+  EGLContextHandle(int majorVersion, int minorVersion, bool debug);
+
+  ~EGLContextHandle();
+
+  // Non-copyable class:
+  EGLContextHandle(const EGLContextHandle &) = delete;
+  EGLContextHandle &operator=(const EGLContextHandle &) = delete;
+
+  // A context can only be current in one thread at a time: release it before
+  // making it current in another thread
+  void makeCurrent() const;
+
+  void releaseCurrent() const;
+
+private:
+  void release();
+
+  // EGLDisplay, EGLSurface and EGLContext, kept opaque so that EGL (and the
+  // platform headers it may pull in) is only included by egl_context.cpp
+  void *m_Display = nullptr;
+  void *m_Surface = nullptr;
+  void *m_Context = nullptr;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "frame_readback.hpp"
+#include "tracing.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+std::size_t getPixelSize(GLenum format, GLenum type)
+{
+  std::size_t componentCount = 4;
+  switch (format)
+  {
+  case GL_RED:
+  case GL_RED_INTEGER:
+    componentCount = 1;
+    break;
+  case GL_RG:
+  case GL_RG_INTEGER:
+    componentCount = 2;
+    break;
+  case GL_RGB:
+  case GL_RGB_INTEGER:
+    componentCount = 3;
+    break;
+  }
+  return componentCount * (type == GL_UNSIGNED_BYTE ? 1 : 4);
+}
+
+} // namespace
+
+FrameReadback::FrameReadback(GLsizei width, GLsizei height, GLenum pixelType, std::size_t ringSize, Consumer consumer) :
+    FrameReadback(width, height, {{GLenum(pixelType == GL_FLOAT ? GL_RGBA32F : GL_RGBA8), GL_RGB, pixelType}}, ringSize, std::move(consumer))
+{
+}
+
+FrameReadback::FrameReadback(
+    GLsizei width, GLsizei height, std::vector<Attachment> attachments, std::size_t ringSize, Consumer consumer) :
+    m_nWidth(width),
+    m_nHeight(height),
+    m_Attachments(std::move(attachments)),
+    m_Consumer(std::move(consumer)),
+    m_Slots(ringSize > 0 ? ringSize : 1)
+{
+  for (const auto &attachment : m_Attachments)
+  {
+    m_AttachmentOffsets.push_back(m_FrameSize);
+    m_FrameSize += std::size_t(width) * height * getPixelSize(attachment.format, attachment.type);
+  }
+
+  GLint previousTextureObject = 0;
+  GLint previousFramebufferObject = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
+
+  // Storage matches the read back type, so that the readback is a plain copy
+  m_ColorTextures.resize(m_Attachments.size());
+  glGenTextures(GLsizei(m_ColorTextures.size()), m_ColorTextures.data());
+  for (std::size_t i = 0; i < m_Attachments.size(); ++i)
+  {
+    glBindTexture(GL_TEXTURE_2D, m_ColorTextures[i]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, m_Attachments[i].internalFormat, m_nWidth, m_nHeight);
+  }
+
+  glGenTextures(1, &m_DepthTexture);
+  glBindTexture(GL_TEXTURE_2D, m_DepthTexture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, m_nWidth, m_nHeight);
+
+  glBindTexture(GL_TEXTURE_2D, previousTextureObject);
+
+  glGenFramebuffers(1, &m_Framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffer);
+  std::vector<GLenum> drawBuffers;
+  for (std::size_t i = 0; i < m_ColorTextures.size(); ++i)
+  {
+    drawBuffers.push_back(GLenum(GL_COLOR_ATTACHMENT0 + i));
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, drawBuffers.back(), m_ColorTextures[i], 0);
+  }
+  glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0);
+  glDrawBuffers(GLsizei(drawBuffers.size()), drawBuffers.data());
+
+  const auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
+
+  for (auto &slot : m_Slots)
+  {
+    glGenBuffers(1, &slot.pixelBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, GLsizeiptr(m_FrameSize), nullptr, GL_MAP_READ_BIT);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameReadback::~FrameReadback()
+{
+  for (auto &slot : m_Slots)
+  {
+    if (slot.fence)
+    {
+      glDeleteSync(slot.fence);
+    }
+    glDeleteBuffers(1, &slot.pixelBuffer);
+  }
+  glDeleteFramebuffers(1, &m_Framebuffer);
+  glDeleteTextures(1, &m_DepthTexture);
+  glDeleteTextures(GLsizei(m_ColorTextures.size()), m_ColorTextures.data());
+}
+
+void FrameReadback::render(const std::function<void()> &drawScene)
+{
+  auto &slot = m_Slots[m_NextSlot];
+  m_NextSlot = (m_NextSlot + 1) % m_Slots.size();
+  if (slot.fence)
+  {
+    retire(slot);
+  }
+
+  GLint previousDrawFramebuffer = 0;
+  GLint previousReadFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+
+  drawScene();
+
+  GLint currentlyBoundFBO = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentlyBoundFBO);
+  if (GLuint(currentlyBoundFBO) != m_Framebuffer)
+  {
+    std::clog << "Warning: FrameReadback - GL_DRAW_FRAMEBUFFER_BINDING has "
+                 "changed during drawScene. It might lead to unexpected behavior."
+              << std::endl;
+  }
+
+  // With a pack buffer bound, glReadPixels only queues a copy and returns
+  // immediately. RGB rows are not necessarily 4 bytes aligned.
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  {
+    ScopedGpuTimer timer{m_pGpuProfiler, "readback"};
+    for (std::size_t i = 0; i < m_Attachments.size(); ++i)
+    {
+      glReadBuffer(GLenum(GL_COLOR_ATTACHMENT0 + i));
+      glReadPixels(0, 0, m_nWidth, m_nHeight, m_Attachments[i].format, m_Attachments[i].type, (GLvoid *)m_AttachmentOffsets[i]);
+    }
+  }
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frameIdx = m_FrameCount++;
+
+  // Make sure the fence reaches the GPU, otherwise waiting on it later could
+  // block forever
+  glFlush();
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDrawFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+}
+
+void FrameReadback::flush()
+{
+  // Oldest frames first, so that the consumer receives them in render order
+  for (std::size_t i = 0; i < m_Slots.size(); ++i)
+  {
+    auto &slot = m_Slots[(m_NextSlot + i) % m_Slots.size()];
+    if (slot.fence)
+    {
+      retire(slot);
+    }
+  }
+}
+
+void FrameReadback::retire(Slot &slot)
+{
+  TRACE_ZONE("readbackFrame");
+  const GLuint64 timeout = 1000000000; // 1 second, in nanoseconds
+  while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout) == GL_TIMEOUT_EXPIRED)
+  {
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+
+  std::vector<unsigned char> pixels(m_FrameSize);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+  const auto *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(m_FrameSize), GL_MAP_READ_BIT);
+  if (mapped)
+  {
+    std::memcpy(pixels.data(), mapped, m_FrameSize);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else
+  {
+    pixels.clear();
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  m_Consumer(slot.frameIdx, std::move(pixels));
+}
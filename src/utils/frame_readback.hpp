@@ -0,0 +1,88 @@
+#pragma once
+
+#include "gpu_profiler.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Offscreen framebuffer whose frames are read back asynchronously through a
+// ring of pixel buffer objects: the GPU copies frame k into a buffer while
+// frame k + 1 is rendered, and the CPU only maps a buffer once its fence is
+// signaled. Pixels are read as tightly packed rows in GL order (bottom row
+// first), so drawScene should flip its projection to get images in the usual
+// top row first order.
+class FrameReadback
+{
+public:
+  // Receive the pixels of a frame, numbered in render order. pixels is empty
+  // if the pixel buffer could not be mapped.
+  using Consumer = std::function<void(std::size_t frameIdx, std::vector<unsigned char> &&pixels)>;
+
+  // Color attachment of the framebuffer, written by the fragment output of the
+  // same index
+  struct Attachment
+  {
+    GLenum internalFormat; // Storage, e.g. GL_RGBA8, GL_R32F or GL_RGBA32UI
+    GLenum format;         // Read back as, e.g. GL_RGB, GL_RED or GL_RGB_INTEGER
+    GLenum type;           // GL_UNSIGNED_BYTE, GL_FLOAT or GL_UNSIGNED_INT
+  };
+
+  // A single RGB attachment of pixelType (GL_UNSIGNED_BYTE or GL_FLOAT)
+  FrameReadback(GLsizei width, GLsizei height, GLenum pixelType, std::size_t ringSize, Consumer consumer);
+
+  // Pixels of all attachments are passed at once, attachment after
+  // attachment, see attachmentOffset()
+  FrameReadback(GLsizei width, GLsizei height, std::vector<Attachment> attachments, std::size_t ringSize, Consumer consumer);
+
+  ~FrameReadback();
+
+  // Non-copyable class:
+  FrameReadback(const FrameReadback &) = delete;
+  FrameReadback &operator=(const FrameReadback &) = delete;
+
+  // Call drawScene with the offscreen framebuffer bound and start the
+  // readback of the frame. Blocks only if all buffers of the ring are in
+  // flight, until the oldest one is ready and passed to the consumer.
+  void render(const std::function<void()> &drawScene);
+
+  // Wait for all frames in flight and pass them to the consumer
+  void flush();
+
+  // Time the copies into pixel buffers in a "readback" scope. profiler can be
+  // null.
+  void setGpuProfiler(GpuProfiler *profiler) { m_pGpuProfiler = profiler; }
+
+  // Offset in bytes of the pixels of an attachment in those of a frame
+  std::size_t attachmentOffset(std::size_t attachmentIdx) const { return m_AttachmentOffsets[attachmentIdx]; }
+
+private:
+  struct Slot
+  {
+    GLuint pixelBuffer = 0;
+    GLsync fence = nullptr;
+    std::size_t frameIdx = 0;
+  };
+
+  // Wait for the readback of a slot in flight, then pass its pixels
+  void retire(Slot &slot);
+
+  GLsizei m_nWidth;
+  GLsizei m_nHeight;
+  std::vector<Attachment> m_Attachments;
+  std::vector<std::size_t> m_AttachmentOffsets;
+  std::size_t m_FrameSize = 0; // In bytes
+  Consumer m_Consumer;
+
+  std::vector<GLuint> m_ColorTextures;
+  GLuint m_DepthTexture = 0;
+  GLuint m_Framebuffer = 0;
+
+  GpuProfiler *m_pGpuProfiler = nullptr;
+
+  std::vector<Slot> m_Slots;
+  std::size_t m_NextSlot = 0;
+  std::size_t m_FrameCount = 0;
+};
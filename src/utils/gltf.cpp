@@ -1,9 +1,16 @@
 #include "gltf.hpp"
+#include "thread_pool.hpp"
+#include "tracing.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <stb_image.h>
+
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <mutex>
 
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix)
@@ -35,119 +42,464 @@ glm::mat4 getLocalToWorldMatrix(
                                                  node.scale[1], node.scale[2]));
 };
 
-void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax)
+// tinygltf image loading callback that only records encoded bytes, so that
+// decoding can be deferred and parallelized (see decodeGltfImages)
+static bool recordEncodedImage(tinygltf::Image *image, const int imageIdx,
+    std::string * /* err */, std::string * /* warn */, int /* reqWidth */,
+    int /* reqHeight */, const unsigned char *bytes, int size, void *userData)
+{
+  auto &encodedImages = *static_cast<std::vector<EncodedImage> *>(userData);
+  if (size_t(imageIdx) >= encodedImages.size()) {
+    encodedImages.resize(imageIdx + 1);
+  }
+  // Bytes of bufferView images live in tinygltf copies of the buffers which
+  // are released after loading, they are resolved from GltfBuffers instead
+  if (image->bufferView < 0) {
+    encodedImages[imageIdx].ownedBytes.assign(bytes, bytes + size);
+  }
+  return true;
+}
+
+// Return false if index is not a valid index in a vector of size count
+static bool isValidIndex(int index, size_t count)
+{
+  return index >= 0 && size_t(index) < count;
+}
+
+static bool validateAccessor(
+    const tinygltf::Model &model, size_t accessorIdx, std::string &err)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  const auto name = "accessor " + std::to_string(accessorIdx);
+  // Accessors without buffer view are filled with zeros
+  if (accessor.bufferView < 0) {
+    return true;
+  }
+  if (size_t(accessor.bufferView) >= model.bufferViews.size()) {
+    err = name + " references an invalid buffer view";
+    return false;
+  }
+  const auto componentSize =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  const auto componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto byteStride = accessor.ByteStride(bufferView);
+  if (componentSize <= 0 || componentCount <= 0 || byteStride <= 0) {
+    err = name + " has an invalid type or byte stride";
+    return false;
+  }
+  // Each element takes at least one byte, which bounds count before the
+  // products below
+  const auto elementSize = uint64_t(componentSize) * uint64_t(componentCount);
+  if (accessor.count > 0 &&
+      (accessor.count > bufferView.byteLength ||
+          uint64_t(accessor.byteOffset) +
+                  uint64_t(accessor.count - 1) * uint64_t(byteStride) +
+                  elementSize >
+              bufferView.byteLength)) {
+    err = name + " reads past the end of its buffer view";
+    return false;
+  }
+  return true;
+}
+
+// Check that every index of the primitive references one of its vertices
+static bool validateIndices(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &buffers,
+    const tinygltf::Primitive &primitive, std::string &err)
 {
-  // Compute scene bounding box
-  // todo refactor with scene drawing
-  // todo need a visitScene generic function that takes a accept() functor
+  const auto &accessor = model.accessors[primitive.indices];
+  const auto name = "index accessor " + std::to_string(primitive.indices);
+  if (accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+      accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+      accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+    err = name + " has an unsupported component type";
+    return false;
+  }
+  const auto positionIt = primitive.attributes.find("POSITION");
+  if (accessor.bufferView < 0 || positionIt == end(primitive.attributes)) {
+    return true;
+  }
+  const auto vertexCount = model.accessors[(*positionIt).second].count;
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto byteStride = size_t(accessor.ByteStride(bufferView));
+  const auto *data = buffers[bufferView.buffer].data + bufferView.byteOffset +
+                     accessor.byteOffset;
+  for (size_t i = 0; i < accessor.count; ++i) {
+    const auto *element = data + i * byteStride;
+    uint32_t index = 0;
+    switch (accessor.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      index = *element;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t shortIndex;
+      std::memcpy(&shortIndex, element, sizeof(shortIndex));
+      index = shortIndex;
+      break;
+    }
+    default:
+      std::memcpy(&index, element, sizeof(index));
+      break;
+    }
+    if (index >= vertexCount) {
+      err = name + " references a vertex out of its primitive";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool validateGltfModel(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &buffers, std::string &err)
+{
+  TRACE_ZONE("validateGltfModel");
+  for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+    const auto &bufferView = model.bufferViews[i];
+    if (!isValidIndex(bufferView.buffer, buffers.size()) ||
+        bufferView.byteOffset > buffers[bufferView.buffer].size ||
+        bufferView.byteLength >
+            buffers[bufferView.buffer].size - bufferView.byteOffset) {
+      err = "buffer view " + std::to_string(i) +
+            " is out of the bounds of its buffer";
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.accessors.size(); ++i) {
+    if (!validateAccessor(model, i, err)) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.images.size(); ++i) {
+    const auto bufferView = model.images[i].bufferView;
+    if (bufferView >= 0 &&
+        size_t(bufferView) >= model.bufferViews.size()) {
+      err = "image " + std::to_string(i) +
+            " references an invalid buffer view";
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.textures.size(); ++i) {
+    const auto &texture = model.textures[i];
+    if (!isValidIndex(texture.source, model.images.size()) ||
+        (texture.sampler >= 0 &&
+            size_t(texture.sampler) >= model.samplers.size())) {
+      err = "texture " + std::to_string(i) +
+            " references an invalid image or sampler";
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.materials.size(); ++i) {
+    const auto &material = model.materials[i];
+    for (const auto textureIdx :
+        {material.pbrMetallicRoughness.baseColorTexture.index,
+            material.pbrMetallicRoughness.metallicRoughnessTexture.index,
+            material.emissiveTexture.index, material.occlusionTexture.index,
+            material.normalTexture.index}) {
+      if (textureIdx >= 0 && size_t(textureIdx) >= model.textures.size()) {
+        err = "material " + std::to_string(i) +
+              " references an invalid texture";
+        return false;
+      }
+    }
+  }
+
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+    for (const auto &primitive : model.meshes[meshIdx].primitives) {
+      const auto name = "primitive of mesh " + std::to_string(meshIdx);
+      for (const auto &attribute : primitive.attributes) {
+        if (!isValidIndex(attribute.second, model.accessors.size())) {
+          err = name + " references an invalid accessor";
+          return false;
+        }
+      }
+      if (primitive.material >= 0 &&
+          size_t(primitive.material) >= model.materials.size()) {
+        err = name + " references an invalid material";
+        return false;
+      }
+      if (primitive.indices >= 0) {
+        if (size_t(primitive.indices) >= model.accessors.size()) {
+          err = name + " references an invalid accessor";
+          return false;
+        }
+        if (!validateIndices(model, buffers, primitive, err)) {
+          return false;
+        }
+      }
+    }
+  }
+
+  // Nodes reachable from a scene must form a tree: roots have no parent and
+  // other nodes a single one
+  std::vector<int> parents(model.nodes.size(), -1);
+  for (size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx) {
+    const auto &node = model.nodes[nodeIdx];
+    const auto name = "node " + std::to_string(nodeIdx);
+    if (node.mesh >= 0 && size_t(node.mesh) >= model.meshes.size()) {
+      err = name + " references an invalid mesh";
+      return false;
+    }
+    for (const auto child : node.children) {
+      if (!isValidIndex(child, model.nodes.size()) || parents[child] >= 0) {
+        err = name + " has an invalid or shared child";
+        return false;
+      }
+      parents[child] = int(nodeIdx);
+    }
+  }
+  for (size_t sceneIdx = 0; sceneIdx < model.scenes.size(); ++sceneIdx) {
+    for (const auto nodeIdx : model.scenes[sceneIdx].nodes) {
+      if (!isValidIndex(nodeIdx, model.nodes.size()) ||
+          parents[nodeIdx] >= 0) {
+        err = "scene " + std::to_string(sceneIdx) +
+              " has an invalid root node";
+        return false;
+      }
+    }
+  }
+  if (model.defaultScene >= 0 &&
+      size_t(model.defaultScene) >= model.scenes.size()) {
+    err = "invalid default scene";
+    return false;
+  }
+
+  return true;
+}
+
+bool loadGltfModel(const fs::path &path, tinygltf::Model &model,
+    GltfBuffers &buffers, std::vector<EncodedImage> &encodedImages,
+    std::string &err, std::string &warn)
+{
+  TRACE_ZONE("loadGltfModel");
+  MappedFile file{path};
+  if (!file.isOpen()) {
+    err = "Unable to map file " + path.string();
+    return false;
+  }
+  if (file.size() > std::numeric_limits<unsigned int>::max()) {
+    err = "File too large for tinygltf: " + path.string();
+    return false;
+  }
+
+  const auto baseDir = path.parent_path();
+  const auto isBinary =
+      file.size() >= 20 && std::memcmp(file.data(), "glTF", 4) == 0;
+
+  tinygltf::TinyGLTF loader;
+  encodedImages.clear();
+  loader.SetImageLoader(recordEncodedImage, &encodedImages);
+  const auto ret =
+      isBinary ? loader.LoadBinaryFromMemory(&model, &err, &warn, file.data(),
+                     static_cast<unsigned int>(file.size()), baseDir.string())
+               : loader.LoadASCIIFromString(&model, &err, &warn,
+                     reinterpret_cast<const char *>(file.data()),
+                     static_cast<unsigned int>(file.size()), baseDir.string());
+  if (!ret) {
+    return false;
+  }
+
+  // The BIN chunk follows the 12 bytes header and the JSON chunk (8 bytes of
+  // chunk header + JSON content, padded to 4 bytes). It is only mapped if its
+  // own header is valid: its length must fit in the file and its type be BIN.
+  std::size_t binChunkOffset = 0;
+  std::size_t binChunkLength = 0;
+  if (isBinary) {
+    uint32_t jsonChunkLength = 0;
+    std::memcpy(&jsonChunkLength, file.data() + 12, 4);
+    const auto binHeaderOffset = 20 + std::size_t(jsonChunkLength);
+    if (binHeaderOffset + 8 <= file.size()) {
+      uint32_t chunkLength = 0, chunkType = 0;
+      std::memcpy(&chunkLength, file.data() + binHeaderOffset, 4);
+      std::memcpy(&chunkType, file.data() + binHeaderOffset + 4, 4);
+      if (chunkType == 0x004E4942 &&
+          binHeaderOffset + 8 + chunkLength <= file.size()) {
+        binChunkOffset = binHeaderOffset + 8;
+        binChunkLength = chunkLength;
+      }
+    }
+  }
+  auto binChunkIsUsed = false;
+
+  buffers.bytes.resize(model.buffers.size());
+  for (size_t i = 0; i < model.buffers.size(); ++i) {
+    auto &buffer = model.buffers[i];
+    const auto byteLength = buffer.data.size();
+
+    const unsigned char *pMapped = nullptr;
+    if (buffer.uri.empty()) {
+      if (binChunkOffset && byteLength <= binChunkLength) {
+        pMapped = file.data() + binChunkOffset;
+        binChunkIsUsed = true;
+      }
+    } else if (!tinygltf::IsDataURI(buffer.uri)) {
+      MappedFile externalFile{baseDir / buffer.uri};
+      // tinygltf checks that the file size matches the buffer byteLength, if
+      // it is not the case the file has been resolved differently
+      if (externalFile.isOpen() && externalFile.size() == byteLength) {
+        pMapped = externalFile.data();
+        buffers.mappedFiles.emplace_back(std::move(externalFile));
+      }
+    }
+
+    if (pMapped) {
+      buffers.bytes[i] = {pMapped, byteLength};
+      std::vector<unsigned char>().swap(buffer.data);
+    } else {
+      buffers.bytes[i] = {buffer.data.data(), byteLength};
+    }
+  }
+
+  if (binChunkIsUsed) {
+    buffers.mappedFiles.emplace_back(std::move(file));
+  }
+
+  // Everything read from buffers afterwards relies on this validation
+  if (!validateGltfModel(model, buffers.bytes, err)) {
+    return false;
+  }
+
+  // Images that failed to load (e.g. missing external files) are not
+  // recorded by the callback
+  encodedImages.resize(model.images.size());
+  for (size_t i = 0; i < model.images.size(); ++i) {
+    auto &encodedImage = encodedImages[i];
+    const auto &image = model.images[i];
+    if (image.bufferView >= 0) {
+      const auto &bufferView = model.bufferViews[image.bufferView];
+      encodedImage.bytes = {
+          buffers.bytes[bufferView.buffer].data + bufferView.byteOffset,
+          bufferView.byteLength};
+    } else {
+      encodedImage.bytes = {
+          encodedImage.ownedBytes.data(), encodedImage.ownedBytes.size()};
+    }
+  }
+
+  return true;
+}
+
+bool decodeGltfImages(tinygltf::Model &model,
+    const std::vector<EncodedImage> &encodedImages, ThreadPool &pool,
+    std::string &err)
+{
+  TRACE_ZONE("decodeGltfImages");
+  auto success = true;
+  std::mutex errMutex;
+  pool.parallelFor(model.images.size(), [&](size_t imageIdx) {
+    TRACE_ZONE("decodeImage");
+    auto &image = model.images[imageIdx];
+    const auto &bytes = encodedImages[imageIdx].bytes;
+    if (!bytes.size) {
+      return;
+    }
+    const auto *pBytes = bytes.data;
+    const auto size = int(bytes.size);
+
+    int width = 0, height = 0, component = 0;
+    const auto is16Bit = stbi_is_16_bit_from_memory(pBytes, size) != 0;
+    auto *pixels = is16Bit ? reinterpret_cast<unsigned char *>(
+                                 stbi_load_16_from_memory(
+                                     pBytes, size, &width, &height, &component, 0))
+                           : stbi_load_from_memory(
+                                 pBytes, size, &width, &height, &component, 0);
+    if (!pixels) {
+      std::lock_guard<std::mutex> lock{errMutex};
+      success = false;
+      err += "Unable to decode image[" + std::to_string(imageIdx) +
+             "] name = \"" + image.name + "\"\n";
+      return;
+    }
+
+    const auto bits = is16Bit ? 16 : 8;
+    image.width = width;
+    image.height = height;
+    image.component = component;
+    image.bits = bits;
+    image.pixel_type = is16Bit ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+                               : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    image.image.assign(pixels, pixels + size_t(width) * size_t(height) *
+                                            size_t(component) * (bits / 8));
+    stbi_image_free(pixels);
+  });
+  return success;
+}
+
+std::vector<std::vector<Bounds>> computePrimitiveBounds(
+    const tinygltf::Model &model, const std::vector<BufferBytes> &buffers)
+{
+  TRACE_ZONE("computePrimitiveBounds");
+  std::vector<std::vector<Bounds>> meshPrimitiveBounds(model.meshes.size());
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+    for (const auto &primitive : model.meshes[meshIdx].primitives) {
+      Bounds bounds{glm::vec3(std::numeric_limits<float>::max()),
+          glm::vec3(std::numeric_limits<float>::lowest())};
+      const auto positionAttrIdxIt = primitive.attributes.find("POSITION");
+      if (positionAttrIdxIt != end(primitive.attributes)) {
+        const auto &accessor = model.accessors[(*positionAttrIdxIt).second];
+        if (accessor.type != TINYGLTF_TYPE_VEC3 ||
+            accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+          std::cerr << "Position accessor with type != VEC3 of floats, "
+                       "skipping"
+                    << std::endl;
+        } else if (accessor.minValues.size() == 3 &&
+                   accessor.maxValues.size() == 3) {
+          bounds.min = glm::vec3(accessor.minValues[0], accessor.minValues[1],
+              accessor.minValues[2]);
+          bounds.max = glm::vec3(accessor.maxValues[0], accessor.maxValues[1],
+              accessor.maxValues[2]);
+        } else if (accessor.bufferView >= 0) {
+          const auto &bufferView = model.bufferViews[accessor.bufferView];
+          const auto *positions = buffers[bufferView.buffer].data +
+                                  bufferView.byteOffset + accessor.byteOffset;
+          const auto byteStride = size_t(accessor.ByteStride(bufferView));
+          for (size_t i = 0; i < accessor.count; ++i) {
+            glm::vec3 position;
+            std::memcpy(
+                &position, positions + i * byteStride, sizeof(position));
+            bounds.min = glm::min(bounds.min, position);
+            bounds.max = glm::max(bounds.max, position);
+          }
+        } else if (accessor.count > 0) {
+          // Positions without buffer view are zeros
+          bounds = {glm::vec3(0), glm::vec3(0)};
+        }
+      }
+      meshPrimitiveBounds[meshIdx].push_back(bounds);
+    }
+  }
+  return meshPrimitiveBounds;
+}
+
+void computeSceneBounds(const SceneGraph &sceneGraph,
+    const std::vector<std::vector<Bounds>> &meshPrimitiveBounds,
+    glm::vec3 &bboxMin, glm::vec3 &bboxMax)
+{
+  TRACE_ZONE("computeSceneBounds");
   bboxMin = glm::vec3(std::numeric_limits<float>::max());
   bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
-  if (model.defaultScene >= 0) {
-    const std::function<void(int, const glm::mat4 &)> updateBounds =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          const auto &node = model.nodes[nodeIdx];
-          const glm::mat4 modelMatrix =
-              getLocalToWorldMatrix(node, parentMatrix);
-          if (node.mesh >= 0) {
-            const auto &mesh = model.meshes[node.mesh];
-            for (size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
-              const auto &primitive = mesh.primitives[pIdx];
-              const auto positionAttrIdxIt =
-                  primitive.attributes.find("POSITION");
-              if (positionAttrIdxIt == end(primitive.attributes)) {
-                continue;
-              }
-              const auto &positionAccessor =
-                  model.accessors[(*positionAttrIdxIt).second];
-              if (positionAccessor.type != 3) {
-                std::cerr << "Position accessor with type != VEC3, skipping"
-                          << std::endl;
-                continue;
-              }
-              const auto &positionBufferView =
-                  model.bufferViews[positionAccessor.bufferView];
-              const auto byteOffset =
-                  positionAccessor.byteOffset + positionBufferView.byteOffset;
-              const auto &positionBuffer =
-                  model.buffers[positionBufferView.buffer];
-              const auto positionByteStride =
-                  positionBufferView.byteStride ? positionBufferView.byteStride
-                                                : 3 * sizeof(float);
-
-              if (primitive.indices >= 0) {
-                const auto &indexAccessor = model.accessors[primitive.indices];
-                const auto &indexBufferView =
-                    model.bufferViews[indexAccessor.bufferView];
-                const auto indexByteOffset =
-                    indexAccessor.byteOffset + indexBufferView.byteOffset;
-                const auto &indexBuffer = model.buffers[indexBufferView.buffer];
-                auto indexByteStride = indexBufferView.byteStride;
-
-                switch (indexAccessor.componentType) {
-                default:
-                  std::cerr
-                      << "Primitive index accessor with bad componentType "
-                      << indexAccessor.componentType << ", skipping it."
-                      << std::endl;
-                  continue;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint8_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint16_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint32_t);
-                  break;
-                }
-
-                for (size_t i = 0; i < indexAccessor.count; ++i) {
-                  uint32_t index = 0;
-                  switch (indexAccessor.componentType) {
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                    index = *((const uint8_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                    index = *((const uint16_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                    index = *((const uint32_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  }
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * index]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              } else {
-                for (size_t i = 0; i < positionAccessor.count; ++i) {
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * i]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              }
-            }
-          }
-          for (const auto childNodeIdx : node.children) {
-            updateBounds(childNodeIdx, modelMatrix);
-          }
-        };
-    for (const auto nodeIdx : model.scenes[model.defaultScene].nodes) {
-      updateBounds(nodeIdx, glm::mat4(1));
+  const auto &nodes = sceneGraph.nodes();
+  for (const auto nodeIdx : sceneGraph.meshNodes()) {
+    const auto &modelMatrix = nodes[nodeIdx].worldMatrix;
+    for (const auto &bounds : meshPrimitiveBounds[nodes[nodeIdx].mesh]) {
+      if (bounds.min.x > bounds.max.x) {
+        continue;
+      }
+      // The transformed box is bounded by its transformed corners
+      for (int corner = 0; corner < 8; ++corner) {
+        const auto localPosition =
+            glm::vec3((corner & 1) ? bounds.max.x : bounds.min.x,
+                (corner & 2) ? bounds.max.y : bounds.min.y,
+                (corner & 4) ? bounds.max.z : bounds.min.z);
+        const auto worldPosition =
+            glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
+        bboxMin = glm::min(bboxMin, worldPosition);
+        bboxMax = glm::max(bboxMax, worldPosition);
+      }
     }
   }
-}
\ No newline at end of file
+}
@@ -1,10 +1,92 @@
 #pragma once
 
+#include "filesystem.hpp"
+#include "mapped_file.hpp"
+#include "scene_graph.hpp"
+
 #include <glm/glm.hpp>
 #include <tiny_gltf.h>
 
+#include <string>
+#include <vector>
+
+// Read-only bytes of a glTF buffer
+struct BufferBytes
+{
+  const unsigned char *data = nullptr;
+  std::size_t size = 0;
+};
+
+// Axis aligned bounding box
+struct Bounds
+{
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// Storage of the buffers of a loaded glTF model. bytes[i] holds the content
+// of model.buffers[i]: when the buffer comes from the BIN chunk of a .glb or
+// from an external file, it points into one of mappedFiles and the copy made
+// by tinygltf in model.buffers[i].data has been released; otherwise (data
+// URIs) it points into model.buffers[i].data.
+// tinygltf still copies every buffer while parsing, so this does not lower
+// the peak memory of loading: it lowers the memory held once the model is
+// loaded, where buffers only use (reclaimable) mapped pages.
+struct GltfBuffers
+{
+  std::vector<MappedFile> mappedFiles;
+  std::vector<BufferBytes> bytes;
+};
+
+// Encoded (png, jpeg, ...) content of a glTF image. Images stored in a
+// bufferView are referenced in place, other ones are copied in ownedBytes.
+struct EncodedImage
+{
+  std::vector<unsigned char> ownedBytes;
+  BufferBytes bytes;
+};
+
+class ThreadPool;
+
+// Load a .gltf or .glb file (the format is detected from the file content).
+// The file is memory mapped instead of being read, and buffer data is
+// accessed in place in the mappings, see GltfBuffers.
+// Images are not decoded: their encoded content is stored in encodedImages
+// (indexed like model.images) and must be decoded with decodeGltfImages().
+// Return false if the file cannot be parsed or the model is invalid, see
+// validateGltfModel().
+bool loadGltfModel(const fs::path &path, tinygltf::Model &model,
+    GltfBuffers &buffers, std::vector<EncodedImage> &encodedImages,
+    std::string &err, std::string &warn);
+
+// Check the references between the objects of model and that accessors,
+// buffer views and indices stay within the bytes of buffers (indexed like
+// model.buffers). Nodes reachable from a scene must form a tree. Called by
+// loadGltfModel(): code reading buffers of a loaded model can assume it holds.
+bool validateGltfModel(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &buffers, std::string &err);
+
+// Decode encodedImages into model.images concurrently on the threads of pool.
+// Images keep their number of channels (no RGBA expansion) and 16 bits per
+// channel images are decoded as such.
+bool decodeGltfImages(tinygltf::Model &model,
+    const std::vector<EncodedImage> &encodedImages, ThreadPool &pool,
+    std::string &err);
+
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix);
 
-void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
\ No newline at end of file
+// Local bounds of the POSITION attribute of each primitive of a valid model
+// (see validateGltfModel()), indexed like model.meshes[i].primitives. They
+// are read from the min and max of accessors when present, as required by
+// glTF, otherwise computed from all positions. Bounds of primitives without
+// float positions are empty (min greater than max).
+std::vector<std::vector<Bounds>> computePrimitiveBounds(
+    const tinygltf::Model &model, const std::vector<BufferBytes> &buffers);
+
+// Bounds of the scene of sceneGraph, whose world matrices must be up to date:
+// union of the bounds of its primitives transformed by the world matrices of
+// the nodes instancing them.
+void computeSceneBounds(const SceneGraph &sceneGraph,
+    const std::vector<std::vector<Bounds>> &meshPrimitiveBounds,
+    glm::vec3 &bboxMin, glm::vec3 &bboxMax);
\ No newline at end of file
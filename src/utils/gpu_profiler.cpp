@@ -0,0 +1,105 @@
+#include "gpu_profiler.hpp"
+
+#include <cassert>
+
+GpuProfiler::~GpuProfiler()
+{
+  for (auto &frame : m_Frames)
+  {
+    glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+  }
+}
+
+void GpuProfiler::beginFrame()
+{
+  assert(!m_bInFrame && "GPU profiler frames cannot be nested");
+  m_nCurrentFrame = (m_nCurrentFrame + 1) % m_Frames.size();
+  auto &frame = m_Frames[m_nCurrentFrame];
+  if (frame.pending)
+  {
+    readTimings(frame);
+  }
+  frame.usedQueryCount = 0;
+  frame.scopes.clear();
+
+  m_bEnabled = m_bEnableRequested;
+  m_bDrawScopes = m_bDrawScopesRequested;
+  m_bInFrame = true;
+}
+
+void GpuProfiler::endFrame()
+{
+  assert(m_OpenScopes.empty() && "GPU profiler scopes must be closed before the end of the frame");
+  auto &frame = m_Frames[m_nCurrentFrame];
+  frame.pending = !frame.scopes.empty();
+  m_bInFrame = false;
+}
+
+void GpuProfiler::beginScope(std::string name)
+{
+  if (!m_bEnabled || !m_bInFrame)
+  {
+    return;
+  }
+  auto &frame = m_Frames[m_nCurrentFrame];
+  const auto query = issueTimestamp(frame);
+  m_OpenScopes.push_back(frame.scopes.size());
+  frame.scopes.push_back({std::move(name), int(m_OpenScopes.size()) - 1, query, 0});
+}
+
+void GpuProfiler::endScope()
+{
+  if (!m_bEnabled || !m_bInFrame || m_OpenScopes.empty())
+  {
+    return;
+  }
+  auto &frame = m_Frames[m_nCurrentFrame];
+  frame.scopes[m_OpenScopes.back()].endQuery = issueTimestamp(frame);
+  m_OpenScopes.pop_back();
+}
+
+const std::vector<float> &GpuProfiler::history(const std::string &name) const
+{
+  static const std::vector<float> empty;
+  const auto it = m_History.find(name);
+  return it != end(m_History) ? it->second : empty;
+}
+
+GLuint GpuProfiler::issueTimestamp(Frame &frame)
+{
+  // Queries are kept from frame to frame, only created when a frame has more
+  // scopes than the previous ones
+  if (frame.usedQueryCount == frame.queries.size())
+  {
+    const auto previousCount = frame.queries.size();
+    frame.queries.resize(previousCount + 64);
+    glGenQueries(64, frame.queries.data() + previousCount);
+  }
+  const auto query = frame.queries[frame.usedQueryCount++];
+  glQueryCounter(query, GL_TIMESTAMP);
+  return query;
+}
+
+void GpuProfiler::readTimings(Frame &frame)
+{
+  m_Timings.clear();
+  for (const auto &scope : frame.scopes)
+  {
+    GLuint64 beginTime = 0, endTime = 0;
+    glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &beginTime);
+    glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &endTime);
+    const auto milliseconds = float(double(endTime - beginTime) * 1e-6);
+    m_Timings.push_back({scope.name, scope.depth, milliseconds});
+
+    if (scope.depth == 0)
+    {
+      auto &history = m_History[scope.name];
+      if (history.size() == HISTORY_SIZE)
+      {
+        history.erase(begin(history));
+      }
+      history.push_back(milliseconds);
+    }
+  }
+  frame.pending = false;
+}
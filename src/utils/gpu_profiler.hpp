@@ -0,0 +1,118 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Measures GPU time of nested scopes with pairs of GL_TIMESTAMP queries. The
+// queries of a frame are read when their set is reused, FRAME_LATENCY frames
+// later, so that reading them does not wait for the GPU. All methods are
+// no-ops while the profiler is disabled.
+class GpuProfiler
+{
+public:
+  struct ScopeTiming
+  {
+    std::string name;
+    int depth; // 0 for top level scopes
+    float milliseconds;
+  };
+
+  static const std::size_t FRAME_LATENCY = 2;
+  static const std::size_t HISTORY_SIZE = 120; // Frames
+
+  GpuProfiler() = default;
+
+  ~GpuProfiler();
+
+  // Non-copyable class:
+  GpuProfiler(const GpuProfiler &) = delete;
+  GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+  // Changes apply from the next frame, so that scopes of a frame stay
+  // balanced
+  void setEnabled(bool enabled) { m_bEnableRequested = enabled; }
+  bool enabled() const { return m_bEnabled; }
+
+  // Scopes around each draw call, see SceneRenderer
+  void setDrawScopesEnabled(bool enabled) { m_bDrawScopesRequested = enabled; }
+  bool drawScopesEnabled() const { return m_bEnabled && m_bDrawScopes; }
+
+  void beginFrame();
+  void endFrame();
+
+  void beginScope(std::string name);
+  void endScope();
+
+  // Scopes of the last frame whose queries have been read, in begin order
+  const std::vector<ScopeTiming> &timings() const { return m_Timings; }
+
+  // Timings of the top level scope name in the last frames, oldest first.
+  // Empty if it never ran.
+  const std::vector<float> &history(const std::string &name) const;
+
+private:
+  struct Scope
+  {
+    std::string name;
+    int depth;
+    GLuint beginQuery;
+    GLuint endQuery;
+  };
+
+  struct Frame
+  {
+    std::vector<GLuint> queries;
+    std::size_t usedQueryCount = 0;
+    std::vector<Scope> scopes;
+    bool pending = false; // Queries issued and not read yet
+  };
+
+  GLuint issueTimestamp(Frame &frame);
+  void readTimings(Frame &frame);
+
+  bool m_bEnabled = false;
+  bool m_bEnableRequested = false;
+  bool m_bDrawScopes = false;
+  bool m_bDrawScopesRequested = false;
+  bool m_bInFrame = false;
+
+  std::array<Frame, FRAME_LATENCY> m_Frames;
+  std::size_t m_nCurrentFrame = 0;
+  std::vector<std::size_t> m_OpenScopes; // Indices in scopes of the current frame
+
+  std::vector<ScopeTiming> m_Timings;
+  std::map<std::string, std::vector<float>> m_History;
+};
+
+// Profile a GPU scope lasting until the end of the current C++ scope.
+// profiler can be null.
+class ScopedGpuTimer
+{
+public:
+  ScopedGpuTimer(GpuProfiler *profiler, std::string name) : m_pProfiler(profiler && profiler->enabled() ? profiler : nullptr)
+  {
+    if (m_pProfiler)
+    {
+      m_pProfiler->beginScope(std::move(name));
+    }
+  }
+
+  ~ScopedGpuTimer()
+  {
+    if (m_pProfiler)
+    {
+      m_pProfiler->endScope();
+    }
+  }
+
+  ScopedGpuTimer(const ScopedGpuTimer &) = delete;
+  ScopedGpuTimer &operator=(const ScopedGpuTimer &) = delete;
+
+private:
+  GpuProfiler *m_pProfiler;
+};
@@ -0,0 +1,319 @@
+#include "image_writer.hpp"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+bool writePortableImage(
+    const fs::path &path, const char *magic, const char *scale, int width, int height, const char *rows, size_t rowSize, bool bottomUp)
+{
+  std::ofstream output{path.string(), std::ios::binary};
+  output << magic << "\n" << width << " " << height << "\n" << scale << "\n";
+  for (int y = 0; y < height; ++y)
+  {
+    const auto row = bottomUp ? height - 1 - y : y;
+    output.write(rows + row * rowSize, rowSize);
+  }
+  return bool(output);
+}
+
+uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc = 0)
+{
+  static const auto table = []() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t n = 0; n < 256; ++n)
+    {
+      auto c = n;
+      for (int k = 0; k < 8; ++k)
+      {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[n] = c;
+    }
+    return table;
+  }();
+
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+  {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void writeBigEndian(std::ofstream &output, uint32_t value)
+{
+  const unsigned char bytes[] = {
+      (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value};
+  output.write((const char *)bytes, 4);
+}
+
+int paethPredictor(int a, int b, int c)
+{
+  const auto p = a + b - c;
+  const auto pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Filter a row of RGB8 pixels with the PNG filter type whose output has the
+// smallest sum of absolute values, as stb_image_write does. filtered starts
+// with the filter type. candidate is a scratch row of rowSize bytes.
+void filterPngRow(
+    const unsigned char *row, const unsigned char *previousRow, size_t rowSize, unsigned char *candidate, unsigned char *filtered)
+{
+  const size_t BYTES_PER_PIXEL = 3;
+  auto bestSum = -1;
+  for (unsigned char type = 0; type < 5; ++type)
+  {
+    auto sum = 0;
+    for (size_t i = 0; i < rowSize; ++i)
+    {
+      const int a = i >= BYTES_PER_PIXEL ? row[i - BYTES_PER_PIXEL] : 0;
+      const int b = previousRow[i];
+      const int c = i >= BYTES_PER_PIXEL ? previousRow[i - BYTES_PER_PIXEL] : 0;
+      const int predictors[] = {0, a, b, (a + b) / 2, paethPredictor(a, b, c)};
+      candidate[i] = (unsigned char)(row[i] - predictors[type]);
+      sum += std::abs((signed char)candidate[i]);
+    }
+    if (bestSum < 0 || sum < bestSum)
+    {
+      bestSum = sum;
+      filtered[0] = type;
+      std::copy(candidate, candidate + rowSize, filtered + 1);
+    }
+  }
+}
+
+} // namespace
+
+bool getImageFormat(const fs::path &path, ImageFormat &format)
+{
+  const auto extension = path.extension().string();
+  return !extension.empty() && parseImageFormat(extension.substr(1), format);
+}
+
+bool parseImageFormat(const std::string &name, ImageFormat &format)
+{
+  std::string lowerName = name;
+  std::transform(begin(lowerName), end(lowerName), begin(lowerName), [](unsigned char c) { return char(std::tolower(c)); });
+  if (lowerName == "png")
+  {
+    format = ImageFormat::PNG;
+  } else if (lowerName == "jpg" || lowerName == "jpeg")
+  {
+    format = ImageFormat::JPEG;
+  } else if (lowerName == "ppm")
+  {
+    format = ImageFormat::PPM;
+  } else if (lowerName == "pfm")
+  {
+    format = ImageFormat::PFM;
+  } else if (lowerName == "hdr")
+  {
+    format = ImageFormat::HDR;
+  } else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool isFloatImageFormat(ImageFormat format)
+{
+  return format == ImageFormat::PFM || format == ImageFormat::HDR;
+}
+
+void configureImageWriter(const ImageWriterOptions &options)
+{
+  stbi_write_png_compression_level = options.pngCompressionLevel;
+}
+
+bool writeImage(const fs::path &path, int width, int height, const void *pixels, const ImageWriterOptions &options, std::string &err)
+{
+  const auto strPath = path.string();
+  auto ret = false;
+  switch (options.format)
+  {
+  case ImageFormat::PNG:
+    ret = stbi_write_png(strPath.c_str(), width, height, 3, pixels, 0) != 0;
+    break;
+  case ImageFormat::JPEG:
+    ret = stbi_write_jpg(strPath.c_str(), width, height, 3, pixels, options.jpegQuality) != 0;
+    break;
+  case ImageFormat::PPM:
+    ret = writePortableImage(path, "P6", "255", width, height, (const char *)pixels, size_t(width) * 3, false);
+    break;
+  case ImageFormat::PFM:
+    // PFM rows are stored bottom row first, -1 means little endian
+    ret = writePortableImage(path, "PF", "-1.0", width, height, (const char *)pixels, size_t(width) * 3 * sizeof(float), true);
+    break;
+  case ImageFormat::HDR:
+    ret = stbi_write_hdr(strPath.c_str(), width, height, 3, (const float *)pixels) != 0;
+    break;
+  }
+
+  if (!ret)
+  {
+    err = "unable to write " + strPath;
+  }
+  return ret;
+}
+
+bool writeFloatImage(const fs::path &path, int width, int height, int channelCount, const void *pixels, std::string &err)
+{
+  // Pf is the greyscale variant of PF
+  if (!writePortableImage(path, channelCount == 1 ? "Pf" : "PF", "-1.0", width, height, (const char *)pixels,
+          size_t(width) * channelCount * sizeof(float), true))
+  {
+    err = "unable to write " + path.string();
+    return false;
+  }
+  return true;
+}
+
+bool StreamingImageWriter::canStream(ImageFormat format)
+{
+  return format == ImageFormat::PNG || format == ImageFormat::PPM || format == ImageFormat::PFM;
+}
+
+bool StreamingImageWriter::open(const fs::path &path, int width, int height, const ImageWriterOptions &options, std::string &err)
+{
+  if (!canStream(options.format))
+  {
+    err = "only png, ppm and pfm images can be written band by band";
+    return false;
+  }
+
+  m_Path = path;
+  m_nWidth = width;
+  m_nHeight = height;
+  m_nWrittenRows = 0;
+  m_Format = options.format;
+  m_RowSize = size_t(width) * 3 * (isFloatImageFormat(m_Format) ? sizeof(float) : 1);
+  m_Output.open(path.string(), std::ios::binary | std::ios::trunc);
+
+  switch (m_Format)
+  {
+  case ImageFormat::PNG:
+  {
+    static const unsigned char signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    m_Output.write((const char *)signature, sizeof(signature));
+    // 8 bits RGB, deflate, adaptive filtering, not interlaced
+    const unsigned char header[] = {(unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8),
+        (unsigned char)width, (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8),
+        (unsigned char)height, 8, 2, 0, 0, 0};
+    writePngChunk("IHDR", header, sizeof(header));
+    m_pZlibStream = std::make_unique<ZlibStream>(options.pngCompressionLevel);
+    m_PreviousRow.assign(m_RowSize, 0);
+    m_FilterCandidate.resize(m_RowSize);
+    break;
+  }
+  case ImageFormat::PPM:
+    m_Output << "P6\n" << width << " " << height << "\n255\n";
+    break;
+  default:
+    // PFM rows are stored bottom row first: the file is allocated here and
+    // bands are written at their place
+    m_Output << "PF\n" << width << " " << height << "\n-1.0\n";
+    m_HeaderSize = m_Output.tellp();
+    m_Output.seekp(m_HeaderSize + std::streamoff(m_RowSize * height) - 1);
+    m_Output.put(0);
+    break;
+  }
+
+  if (!m_Output)
+  {
+    err = "unable to write " + path.string();
+    return false;
+  }
+  return true;
+}
+
+bool StreamingImageWriter::writeRows(const void *pixels, int rowCount, std::string &err)
+{
+  if (rowCount > m_nHeight - m_nWrittenRows)
+  {
+    err = "too many rows written to " + m_Path.string();
+    return false;
+  }
+
+  const auto rows = (const unsigned char *)pixels;
+  switch (m_Format)
+  {
+  case ImageFormat::PNG:
+  {
+    m_FilteredRows.resize((m_RowSize + 1) * rowCount);
+    for (int y = 0; y < rowCount; ++y)
+    {
+      const auto row = rows + y * m_RowSize;
+      filterPngRow(row, m_PreviousRow.data(), m_RowSize, m_FilterCandidate.data(), m_FilteredRows.data() + y * (m_RowSize + 1));
+      std::copy(row, row + m_RowSize, begin(m_PreviousRow));
+    }
+    m_pZlibStream->write(m_FilteredRows.data(), m_FilteredRows.size());
+    auto &compressed = m_pZlibStream->output();
+    writePngChunk("IDAT", compressed.data(), compressed.size());
+    compressed.clear();
+    break;
+  }
+  case ImageFormat::PPM:
+    m_Output.write((const char *)rows, m_RowSize * rowCount);
+    break;
+  default:
+    for (int y = 0; y < rowCount; ++y)
+    {
+      m_Output.seekp(m_HeaderSize + std::streamoff(m_RowSize * (m_nHeight - 1 - m_nWrittenRows - y)));
+      m_Output.write((const char *)rows + y * m_RowSize, m_RowSize);
+    }
+    break;
+  }
+  m_nWrittenRows += rowCount;
+
+  if (!m_Output)
+  {
+    err = "unable to write " + m_Path.string();
+    return false;
+  }
+  return true;
+}
+
+bool StreamingImageWriter::close(std::string &err)
+{
+  if (m_Format == ImageFormat::PNG && m_pZlibStream)
+  {
+    m_pZlibStream->finish();
+    auto &compressed = m_pZlibStream->output();
+    writePngChunk("IDAT", compressed.data(), compressed.size());
+    writePngChunk("IEND", nullptr, 0);
+    m_pZlibStream.reset();
+  }
+  m_Output.close();
+
+  if (!m_Output)
+  {
+    err = "unable to write " + m_Path.string();
+    return false;
+  }
+  if (m_nWrittenRows != m_nHeight)
+  {
+    err = "missing rows in " + m_Path.string();
+    return false;
+  }
+  return true;
+}
+
+void StreamingImageWriter::writePngChunk(const char *type, const unsigned char *data, std::size_t size)
+{
+  if (size == 0 && std::string{type} == "IDAT")
+  {
+    return; // Nothing compressed yet
+  }
+  writeBigEndian(m_Output, uint32_t(size));
+  m_Output.write(type, 4);
+  m_Output.write((const char *)data, size);
+  writeBigEndian(m_Output, crc32(data, size, crc32((const unsigned char *)type, 4)));
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "deflate.hpp"
+#include "filesystem.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// File formats of offscreen renders
+enum class ImageFormat
+{
+  PNG,
+  JPEG,
+  PPM, // Binary RGB8, uncompressed
+  PFM, // Binary RGB32F, uncompressed
+  HDR, // Radiance RGBE
+};
+
+struct ImageWriterOptions
+{
+  ImageFormat format = ImageFormat::PNG;
+  int pngCompressionLevel = 8; // zlib level, from 0 (fastest) to 9
+  int jpegQuality = 90;        // From 1 to 100
+};
+
+// Parse a format name (png, jpg/jpeg, ppm, pfm or hdr). Return false if the
+// name is unknown.
+bool parseImageFormat(const std::string &name, ImageFormat &format);
+
+// Format of an image path, from its extension. Return false if the extension
+// is not one of those of parseImageFormat().
+bool getImageFormat(const fs::path &path, ImageFormat &format);
+
+// Float formats are written from RGB32F pixels, the others from RGB8 pixels
+bool isFloatImageFormat(ImageFormat format);
+
+// Apply the options that are globals of stb_image_write. Must be called
+// before writing images from several threads.
+void configureImageWriter(const ImageWriterOptions &options);
+
+// Write RGB pixels, top row first, as an image of the given options. Can be
+// called from several threads at once, see configureImageWriter(). Return false
+// and set err on failure.
+bool writeImage(const fs::path &path, int width, int height, const void *pixels, const ImageWriterOptions &options, std::string &err);
+
+// Write float pixels with 1 or 3 channels, top row first, as a PFM image.
+// Return false and set err on failure.
+bool writeFloatImage(const fs::path &path, int width, int height, int channelCount, const void *pixels, std::string &err);
+
+// Write an image band by band, top row first, so that images larger than
+// memory can be encoded while they are rendered. Only formats without global
+// compression can be streamed: PNG (deflated as bands are written), PPM and
+// PFM.
+class StreamingImageWriter
+{
+public:
+  static bool canStream(ImageFormat format);
+
+  // Create the file and write its header. Return false and set err on
+  // failure.
+  bool open(const fs::path &path, int width, int height, const ImageWriterOptions &options, std::string &err);
+
+  // Append rowCount rows of RGB pixels, as for writeImage(). Return false and
+  // set err on failure.
+  bool writeRows(const void *pixels, int rowCount, std::string &err);
+
+  // Terminate the file. Return false and set err if rows are missing or it
+  // could not be written.
+  bool close(std::string &err);
+
+private:
+  void writePngChunk(const char *type, const unsigned char *data, std::size_t size);
+
+  fs::path m_Path;
+  std::ofstream m_Output;
+  int m_nWidth = 0;
+  int m_nHeight = 0;
+  int m_nWrittenRows = 0;
+  ImageFormat m_Format = ImageFormat::PNG;
+  std::size_t m_RowSize = 0; // In bytes
+  std::streamoff m_HeaderSize = 0;
+
+  // PNG: rows are filtered against the previous one, then deflated
+  std::unique_ptr<ZlibStream> m_pZlibStream;
+  std::vector<unsigned char> m_PreviousRow;
+  std::vector<unsigned char> m_FilterCandidate; // Scratch row of filterPngRow()
+  std::vector<unsigned char> m_FilteredRows;
+};
@@ -0,0 +1,135 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const fs::path &path)
+{
+  const auto hFile =
+      CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (hFile == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+  m_hFile = hFile;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+  {
+    close();
+    return;
+  }
+
+  m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_hMapping)
+  {
+    close();
+    return;
+  }
+
+  m_pData = static_cast<const unsigned char *>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+  if (!m_pData)
+  {
+    close();
+    return;
+  }
+  m_nSize = std::size_t(fileSize.QuadPart);
+}
+
+void MappedFile::close()
+{
+  if (m_pData)
+  {
+    UnmapViewOfFile(m_pData);
+  }
+  if (m_hMapping)
+  {
+    CloseHandle(m_hMapping);
+  }
+  if (m_hFile)
+  {
+    CloseHandle(m_hFile);
+  }
+  m_pData = nullptr;
+  m_nSize = 0;
+  m_hMapping = nullptr;
+  m_hFile = nullptr;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue) noexcept
+{
+  if (this != &rvalue)
+  {
+    close();
+    m_pData = std::exchange(rvalue.m_pData, nullptr);
+    m_nSize = std::exchange(rvalue.m_nSize, 0);
+    m_hFile = std::exchange(rvalue.m_hFile, nullptr);
+    m_hMapping = std::exchange(rvalue.m_hMapping, nullptr);
+  }
+  return *this;
+}
+
+#else
+
+MappedFile::MappedFile(const fs::path &path)
+{
+  const auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+  {
+    ::close(fd);
+    return;
+  }
+
+  // The mapping keeps a reference to the file, the descriptor is not needed
+  // anymore once it exists
+  auto *pData = mmap(nullptr, std::size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (pData == MAP_FAILED)
+  {
+    return;
+  }
+
+  m_pData = static_cast<const unsigned char *>(pData);
+  m_nSize = std::size_t(fileStat.st_size);
+}
+
+void MappedFile::close()
+{
+  if (m_pData)
+  {
+    munmap(const_cast<unsigned char *>(m_pData), m_nSize);
+  }
+  m_pData = nullptr;
+  m_nSize = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue) noexcept
+{
+  if (this != &rvalue)
+  {
+    close();
+    m_pData = std::exchange(rvalue.m_pData, nullptr);
+    m_nSize = std::exchange(rvalue.m_nSize, 0);
+  }
+  return *this;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+#include <utility>
+
+// Read-only memory mapping of a whole file. Pages are loaded lazily by the OS
+// and are shared with the page cache, so mapping a file does not copy it.
+// Pointers returned by data() are invalidated when the object is destroyed.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+
+  // Map the file at path. On failure isOpen() returns false.
+  explicit MappedFile(const fs::path &path);
+
+  ~MappedFile() { close(); }
+
+  // Non-copyable, movable class:
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&rvalue) noexcept { *this = std::move(rvalue); }
+
+  MappedFile &operator=(MappedFile &&rvalue) noexcept;
+
+  bool isOpen() const { return m_pData != nullptr; }
+
+  const unsigned char *data() const { return m_pData; }
+
+  std::size_t size() const { return m_nSize; }
+
+private:
+  void close();
+
+  const unsigned char *m_pData = nullptr;
+  std::size_t m_nSize = 0;
+#ifdef _WIN32
+  void *m_hFile = nullptr;
+  void *m_hMapping = nullptr;
+#endif
+};
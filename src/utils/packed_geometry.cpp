@@ -0,0 +1,285 @@
+#include "packed_geometry.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+
+namespace {
+
+const char *const ATTRIBUTE_NAMES[PackedGeometry::ATTRIBUTE_COUNT] = {"POSITION", "NORMAL", "TEXCOORD_0"};
+const int ATTRIBUTE_MAX_COMPONENT_COUNTS[PackedGeometry::ATTRIBUTE_COUNT] = {3, 3, 2};
+const std::size_t POOL_ALIGNMENT = 16;
+
+template <typename T> T load(const unsigned char *bytes)
+{
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+uint32_t alignTo4(uint32_t size)
+{
+  return (size + 3) & ~3u;
+}
+
+// First element of an accessor and the stride between its elements
+const unsigned char *getAccessorData(
+    const tinygltf::Model &model, const std::vector<BufferBytes> &buffers, int accessorIdx, size_t &byteStride)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  byteStride = size_t(accessor.ByteStride(bufferView));
+  return buffers[bufferView.buffer].data + bufferView.byteOffset + accessor.byteOffset;
+}
+
+// Attribute of a primitive as stored in a pool, with the accessor it is read
+// from
+struct SourceAttribute
+{
+  int accessor; // -1 if the primitive does not have the attribute
+  PackedGeometry::Attribute attribute;
+};
+
+bool sameFormat(const std::array<SourceAttribute, PackedGeometry::ATTRIBUTE_COUNT> &attributes, const PackedGeometry::VertexPool &pool)
+{
+  for (size_t i = 0; i < attributes.size(); ++i)
+  {
+    const auto &lhs = attributes[i].attribute;
+    const auto &rhs = pool.attributes[i];
+    if (lhs.componentType != rhs.componentType || lhs.componentCount != rhs.componentCount || lhs.normalized != rhs.normalized)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Vertices of a primitive copied in a pool
+struct VertexCopy
+{
+  std::array<SourceAttribute, PackedGeometry::ATTRIBUTE_COUNT> attributes;
+  uint32_t pool;
+  uint32_t baseVertex;
+  uint32_t vertexCount;
+};
+
+// Indices of a primitive copied in the index pool
+struct IndexCopy
+{
+  int accessor; // -1 for sequential indices
+  uint32_t firstIndex;
+  uint32_t indexCount;
+};
+
+} // namespace
+
+uint64_t PackedGeometry::byteSize() const
+{
+  uint64_t size = indices.size;
+  for (const auto &pool : vertexPools)
+  {
+    size += pool.vertices.size;
+  }
+  return size;
+}
+
+void PackedGeometry::releaseBytes()
+{
+  // Swapped with an empty vector, clear() would keep its capacity
+  std::vector<unsigned char>{}.swap(ownedBytes);
+  for (auto &pool : vertexPools)
+  {
+    pool.vertices = BufferBytes{};
+  }
+  indices = BufferBytes{};
+}
+
+bool packGeometry(const tinygltf::Model &model, const std::vector<BufferBytes> &buffers, PackedGeometry &geometry, std::string &err)
+{
+  geometry = PackedGeometry{};
+  geometry.meshPrimitiveRanges.resize(model.meshes.size());
+
+  // First pass: layout of pools and ranges, and validation of accessors.
+  // Vertices of primitives using the same accessors are copied once.
+  std::vector<VertexCopy> vertexCopies;
+  std::vector<IndexCopy> indexCopies;
+  std::map<std::array<int, PackedGeometry::ATTRIBUTE_COUNT + 1>, size_t> vertexCopyIndex;
+  uint64_t indexCount = 0;
+  uint64_t maxVertexCount = 0;
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx)
+  {
+    const auto &mesh = model.meshes[meshIdx];
+    auto &ranges = geometry.meshPrimitiveRanges[meshIdx];
+    ranges.reserve(mesh.primitives.size());
+    for (const auto &primitive : mesh.primitives)
+    {
+      const auto positionIt = primitive.attributes.find("POSITION");
+      const auto vertexCount = positionIt != end(primitive.attributes) ? model.accessors[(*positionIt).second].count : size_t(0);
+
+      VertexCopy vertexCopy;
+      vertexCopy.vertexCount = uint32_t(vertexCount);
+      std::array<int, PackedGeometry::ATTRIBUTE_COUNT + 1> accessors;
+      uint32_t stride = 0;
+      for (size_t i = 0; i < PackedGeometry::ATTRIBUTE_COUNT; ++i)
+      {
+        auto &source = vertexCopy.attributes[i];
+        source = {-1, {0, 0, 0, 0}};
+        const auto attributeIt = primitive.attributes.find(ATTRIBUTE_NAMES[i]);
+        if (attributeIt != end(primitive.attributes) && model.accessors[(*attributeIt).second].bufferView >= 0)
+        {
+          const auto &accessor = model.accessors[(*attributeIt).second];
+          const auto componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+          const auto componentCount = std::min(tinygltf::GetNumComponentsInType(accessor.type), ATTRIBUTE_MAX_COMPONENT_COUNTS[i]);
+          if (componentSize <= 0 || componentCount <= 0 || accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE)
+          {
+            std::cerr << "Warn : unsupported " << ATTRIBUTE_NAMES[i] << " accessor, ignored" << std::endl;
+          } else
+          {
+            source = {(*attributeIt).second, {accessor.componentType, componentCount, accessor.normalized ? 1 : 0, stride}};
+            stride += alignTo4(uint32_t(componentSize * componentCount));
+          }
+        }
+        accessors[i] = source.accessor;
+      }
+      accessors.back() = int(vertexCount);
+
+      PackedGeometry::Range range;
+      const auto copyIt = vertexCopyIndex.find(accessors);
+      if (copyIt != end(vertexCopyIndex))
+      {
+        const auto &previousCopy = vertexCopies[copyIt->second];
+        range.pool = previousCopy.pool;
+        range.baseVertex = int32_t(previousCopy.baseVertex);
+      } else
+      {
+        auto poolIt = std::find_if(begin(geometry.vertexPools), end(geometry.vertexPools),
+            [&](const PackedGeometry::VertexPool &pool) { return sameFormat(vertexCopy.attributes, pool); });
+        if (poolIt == end(geometry.vertexPools))
+        {
+          PackedGeometry::VertexPool pool;
+          for (size_t i = 0; i < PackedGeometry::ATTRIBUTE_COUNT; ++i)
+          {
+            pool.attributes[i] = vertexCopy.attributes[i].attribute;
+          }
+          pool.stride = stride;
+          pool.vertexCount = 0;
+          geometry.vertexPools.push_back(pool);
+          poolIt = end(geometry.vertexPools) - 1;
+        }
+        if (uint64_t(poolIt->vertexCount) + vertexCount > uint64_t(std::numeric_limits<int32_t>::max()))
+        {
+          err = "too many vertices to be packed";
+          return false;
+        }
+        vertexCopy.pool = uint32_t(poolIt - begin(geometry.vertexPools));
+        vertexCopy.baseVertex = poolIt->vertexCount;
+        poolIt->vertexCount += uint32_t(vertexCount);
+        range.pool = vertexCopy.pool;
+        range.baseVertex = int32_t(vertexCopy.baseVertex);
+        vertexCopyIndex[accessors] = vertexCopies.size();
+        vertexCopies.push_back(vertexCopy);
+      }
+
+      // Primitives without positions are not drawn
+      IndexCopy indexCopy{-1, uint32_t(indexCount), uint32_t(vertexCount)};
+      if (vertexCount > 0 && primitive.indices >= 0 && model.accessors[primitive.indices].bufferView >= 0)
+      {
+        indexCopy.accessor = primitive.indices;
+        indexCopy.indexCount = uint32_t(model.accessors[primitive.indices].count);
+      }
+      if (indexCount + indexCopy.indexCount > uint64_t(std::numeric_limits<uint32_t>::max()))
+      {
+        err = "too many indices to be packed";
+        return false;
+      }
+      indexCount += indexCopy.indexCount;
+      indexCopies.push_back(indexCopy);
+      maxVertexCount = std::max<uint64_t>(maxVertexCount, vertexCount);
+
+      range.firstIndex = indexCopy.firstIndex;
+      range.indexCount = indexCopy.indexCount;
+      ranges.push_back(range);
+    }
+  }
+
+  // Pools are stored one after the other, indices last. Elements missing
+  // from short accessors stay zero filled.
+  geometry.indexSize = maxVertexCount <= 65536 ? 2 : 4;
+  const auto align = [](size_t offset) { return (offset + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT; };
+  std::vector<size_t> poolOffsets;
+  size_t byteSize = 0;
+  for (const auto &pool : geometry.vertexPools)
+  {
+    poolOffsets.push_back(byteSize);
+    byteSize = align(byteSize + size_t(pool.vertexCount) * pool.stride);
+  }
+  const auto indicesOffset = byteSize;
+  byteSize += size_t(indexCount) * geometry.indexSize;
+  geometry.ownedBytes.resize(byteSize);
+  for (size_t poolIdx = 0; poolIdx < geometry.vertexPools.size(); ++poolIdx)
+  {
+    auto &pool = geometry.vertexPools[poolIdx];
+    pool.vertices = {geometry.ownedBytes.data() + poolOffsets[poolIdx], size_t(pool.vertexCount) * pool.stride};
+  }
+  geometry.indices = {geometry.ownedBytes.data() + indicesOffset, size_t(indexCount) * geometry.indexSize};
+
+  // Second pass: copies
+  for (const auto &copy : vertexCopies)
+  {
+    const auto &pool = geometry.vertexPools[copy.pool];
+    auto *vertices = geometry.ownedBytes.data() + poolOffsets[copy.pool] + size_t(copy.baseVertex) * pool.stride;
+    for (const auto &source : copy.attributes)
+    {
+      if (source.accessor < 0)
+      {
+        continue;
+      }
+      const auto &accessor = model.accessors[source.accessor];
+      const auto elementSize = size_t(tinygltf::GetComponentSizeInBytes(source.attribute.componentType)) * source.attribute.componentCount;
+      const auto count = std::min(size_t(copy.vertexCount), accessor.count);
+      size_t byteStride = 0;
+      const auto *data = getAccessorData(model, buffers, source.accessor, byteStride);
+      for (size_t i = 0; i < count; ++i)
+      {
+        std::memcpy(vertices + i * pool.stride + source.attribute.offset, data + i * byteStride, elementSize);
+      }
+    }
+  }
+
+  auto *indices = geometry.ownedBytes.data() + indicesOffset;
+  for (const auto &copy : indexCopies)
+  {
+    const unsigned char *data = nullptr;
+    size_t byteStride = 0;
+    int componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+    if (copy.accessor >= 0)
+    {
+      componentType = model.accessors[copy.accessor].componentType;
+      data = getAccessorData(model, buffers, copy.accessor, byteStride);
+    }
+    for (uint32_t i = 0; i < copy.indexCount; ++i)
+    {
+      uint32_t index = i;
+      if (data)
+      {
+        const auto *element = data + i * byteStride;
+        index = componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE    ? load<uint8_t>(element)
+                : componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ? load<uint16_t>(element)
+                                                                          : load<uint32_t>(element);
+      }
+      auto *destination = indices + (size_t(copy.firstIndex) + i) * geometry.indexSize;
+      if (geometry.indexSize == 2)
+      {
+        const auto shortIndex = uint16_t(index);
+        std::memcpy(destination, &shortIndex, sizeof(shortIndex));
+      } else
+      {
+        std::memcpy(destination, &index, sizeof(index));
+      }
+    }
+  }
+
+  return true;
+}
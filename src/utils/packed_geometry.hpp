@@ -0,0 +1,79 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// POSITION, NORMAL and TEXCOORD_0 of all mesh primitives of a model, packed in
+// a few pools so that the scene is drawn with one vertex array object per
+// vertex format, with glDrawElementsBaseVertex or indirect commands.
+// Attributes keep the component type of their accessors and are interleaved,
+// so that a vertex is fetched from one place; primitives whose attributes
+// have the same types share a vertex pool. Only the elements read by the
+// accessors of primitives are copied, once for primitives sharing the same
+// accessors. Indices of all primitives are relative to their first vertex,
+// in a single pool of 16 bits indices if no primitive has more than 65536
+// vertices, 32 bits otherwise. Primitives without indices get sequential
+// ones.
+struct PackedGeometry
+{
+  static const std::size_t ATTRIBUTE_COUNT = 3; // POSITION, NORMAL, TEXCOORD_0
+
+  struct Attribute
+  {
+    int32_t componentType; // TINYGLTF_COMPONENT_TYPE_*, 0 if the primitives of the pool do not have it
+    int32_t componentCount;
+    int32_t normalized;
+    uint32_t offset; // In a vertex, multiple of 4 bytes
+  };
+
+  struct VertexPool
+  {
+    std::array<Attribute, ATTRIBUTE_COUNT> attributes;
+    uint32_t stride; // Multiple of 4 bytes
+    uint32_t vertexCount;
+    BufferBytes vertices;
+  };
+
+  struct Range
+  {
+    uint32_t pool;       // Index in vertexPools
+    uint32_t firstIndex; // Offset in indices, in indices
+    uint32_t indexCount;
+    int32_t baseVertex; // Offset in the vertices of the pool
+  };
+
+  PackedGeometry() = default;
+
+  // Movable, non-copyable class: pools may point into ownedBytes
+  PackedGeometry(PackedGeometry &&) = default;
+  PackedGeometry &operator=(PackedGeometry &&) = default;
+  PackedGeometry(const PackedGeometry &) = delete;
+  PackedGeometry &operator=(const PackedGeometry &) = delete;
+
+  std::vector<VertexPool> vertexPools;
+  uint32_t indexSize = 4; // In bytes, 2 or 4
+  BufferBytes indices;
+
+  // Range of model.meshes[i].primitives[j] is meshPrimitiveRanges[i][j]
+  std::vector<std::vector<Range>> meshPrimitiveRanges;
+
+  // Storage of vertices and indices, empty when they point into the scene
+  // cache
+  std::vector<unsigned char> ownedBytes;
+
+  uint64_t byteSize() const;
+
+  // Free vertices and indices, only the layout of pools and ranges are kept
+  void releaseBytes();
+};
+
+// Pack the geometry of model, whose buffers hold the bytes of model.buffers.
+// The model must be valid, see validateGltfModel(). Return false if there are
+// too many vertices or indices to be packed.
+bool packGeometry(const tinygltf::Model &model, const std::vector<BufferBytes> &buffers, PackedGeometry &geometry, std::string &err);
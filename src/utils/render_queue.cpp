@@ -0,0 +1,71 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+const uint32_t PROGRAM_BITS = 8;
+const uint32_t MATERIAL_BITS = 16;
+const uint32_t VERTEX_ARRAY_BITS = 20;
+const uint32_t DEPTH_BITS = 20;
+
+static_assert(PROGRAM_BITS + MATERIAL_BITS + VERTEX_ARRAY_BITS + DEPTH_BITS == 64, "Sort key fields must fill 64 bits");
+
+uint64_t truncate(uint64_t value, uint32_t bits) { return value & ((uint64_t(1) << bits) - 1); }
+
+} // namespace
+
+uint64_t RenderQueue::makeKey(uint32_t program, int material, uint32_t vertexArrayObject, float normalizedDepth)
+{
+  const auto depth = uint64_t(std::min(std::max(normalizedDepth, 0.f), 1.f) * float((uint64_t(1) << DEPTH_BITS) - 1));
+  // Draws without material come first
+  return (truncate(program, PROGRAM_BITS) << (MATERIAL_BITS + VERTEX_ARRAY_BITS + DEPTH_BITS)) |
+         (truncate(uint64_t(material + 1), MATERIAL_BITS) << (VERTEX_ARRAY_BITS + DEPTH_BITS)) |
+         (truncate(vertexArrayObject, VERTEX_ARRAY_BITS) << DEPTH_BITS) | depth;
+}
+
+void RenderQueue::sort()
+{
+  if (m_Items.size() < 2)
+  {
+    return;
+  }
+
+  // Bytes whose value differs between keys are the only ones needing a pass
+  uint64_t keyOr = 0;
+  uint64_t keyAnd = ~uint64_t(0);
+  for (const auto &item : m_Items)
+  {
+    keyOr |= item.key;
+    keyAnd &= item.key;
+  }
+  const auto varyingBits = keyOr ^ keyAnd;
+
+  m_SortBuffer.resize(m_Items.size());
+  for (uint32_t shift = 0; shift < 64; shift += 8)
+  {
+    if (((varyingBits >> shift) & 0xFF) == 0)
+    {
+      continue;
+    }
+
+    std::array<std::size_t, 256> offsets{};
+    for (const auto &item : m_Items)
+    {
+      ++offsets[(item.key >> shift) & 0xFF];
+    }
+    std::size_t offset = 0;
+    for (auto &count : offsets)
+    {
+      const auto digitCount = count;
+      count = offset;
+      offset += digitCount;
+    }
+    for (const auto &item : m_Items)
+    {
+      m_SortBuffer[offsets[(item.key >> shift) & 0xFF]++] = item;
+    }
+    m_Items.swap(m_SortBuffer);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Draws of a frame, sorted by a 64 bits key so that draws sharing the same GL
+// state are consecutive. From most to least significant bits, the key is made
+// of the program, the material, the vertex array object and the depth. Only
+// the order depends on the key: consumers must compare actual state values to
+// detect changes, since keys are truncated to the width of their fields.
+class RenderQueue
+{
+public:
+  struct Item
+  {
+    uint64_t key;
+    uint32_t node;      // Index of the node in the SceneGraph
+    uint32_t primitive; // Index of the primitive in the mesh of the node
+  };
+
+  // normalizedDepth is clamped to [0, 1], 0 being the nearest
+  static uint64_t makeKey(uint32_t program, int material, uint32_t vertexArrayObject, float normalizedDepth);
+
+  void clear() { m_Items.clear(); }
+
+  void push(uint64_t key, uint32_t node, uint32_t primitive) { m_Items.push_back({key, node, primitive}); }
+
+  // Least significant digit radix sort on keys. Passes on bytes that are the
+  // same for all keys are skipped.
+  void sort();
+
+  const std::vector<Item> &items() const { return m_Items; }
+
+private:
+  std::vector<Item> m_Items;
+  std::vector<Item> m_SortBuffer;
+};
@@ -0,0 +1,579 @@
+#include "scene_cache.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifndef GLTF_VIEWER_VERSION
+#define GLTF_VIEWER_VERSION "unknown"
+#endif
+
+namespace {
+
+// Increment when the layout of cache files changes
+const uint32_t SCENE_CACHE_FORMAT_VERSION = 5;
+const char SCENE_CACHE_MAGIC[8] = {'G', 'L', 'T', 'F', 'V', 'S', 'C', '\0'};
+const std::size_t SCENE_CACHE_BLOB_ALIGNMENT = 16;
+
+// 64 bits hash processing 8 bytes at a time, seeded so that chunks of a
+// large file can be hashed independently
+uint64_t hashBytes(const unsigned char *data, std::size_t size, uint64_t seed)
+{
+  const uint64_t prime = 0x9E3779B97F4A7C15ull;
+  auto hash = seed ^ (size * prime);
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; ++i)
+  {
+    hash = (hash ^ data[i]) * prime;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+uint64_t hashFileContent(const MappedFile &file, ThreadPool &pool)
+{
+  const std::size_t chunkSize = 64 * 1024 * 1024;
+  const auto chunkCount = (file.size() + chunkSize - 1) / chunkSize;
+  std::vector<uint64_t> chunkHashes(chunkCount);
+  pool.parallelFor(chunkCount, [&](std::size_t chunkIdx) {
+    const auto offset = chunkIdx * chunkSize;
+    chunkHashes[chunkIdx] = hashBytes(file.data() + offset, std::min(chunkSize, file.size() - offset), chunkIdx);
+  });
+  return hashBytes(reinterpret_cast<const unsigned char *>(chunkHashes.data()), chunkHashes.size() * sizeof(uint64_t), file.size());
+}
+
+// External file whose content is part of the model but not of the hash
+struct Dependency
+{
+  std::string path;
+  uint64_t size;
+  int64_t modificationTime;
+};
+
+bool getDependency(const fs::path &path, Dependency &dependency)
+{
+  std::error_code error;
+  const auto size = fs::file_size(path, error);
+  if (error)
+  {
+    return false;
+  }
+  const auto modificationTime = fs::last_write_time(path, error);
+  if (error)
+  {
+    return false;
+  }
+  dependency = {path.string(), uint64_t(size), int64_t(modificationTime.time_since_epoch().count())};
+  return true;
+}
+
+std::vector<Dependency> getDependencies(const fs::path &gltfFile, const tinygltf::Model &model)
+{
+  std::vector<std::string> uris;
+  for (const auto &buffer : model.buffers)
+  {
+    uris.emplace_back(buffer.uri);
+  }
+  for (const auto &image : model.images)
+  {
+    uris.emplace_back(image.uri);
+  }
+
+  std::vector<Dependency> dependencies;
+  for (const auto &uri : uris)
+  {
+    Dependency dependency;
+    if (!uri.empty() && !tinygltf::IsDataURI(uri) && getDependency(fs::absolute(gltfFile).parent_path() / uri, dependency))
+    {
+      dependencies.emplace_back(dependency);
+    }
+  }
+  return dependencies;
+}
+
+class CacheWriter
+{
+public:
+  explicit CacheWriter(const fs::path &path) : m_Output(path.string(), std::ios::binary) {}
+
+  bool good() const { return m_Output.good(); }
+
+  template <typename T>
+  void write(const T &value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be written");
+    writeBytes(&value, sizeof(T));
+  }
+
+  void writeString(const std::string &str)
+  {
+    write(uint32_t(str.size()));
+    writeBytes(str.data(), str.size());
+  }
+
+  template <typename T>
+  void writeVector(const std::vector<T> &values)
+  {
+    write(uint32_t(values.size()));
+    writeBytes(values.data(), values.size() * sizeof(T));
+  }
+
+  // Blobs are aligned so that they can be used in place from a mapping
+  void writeBlob(const unsigned char *data, std::size_t size)
+  {
+    write(uint64_t(size));
+    const char padding[SCENE_CACHE_BLOB_ALIGNMENT] = {};
+    writeBytes(padding, (SCENE_CACHE_BLOB_ALIGNMENT - m_nOffset % SCENE_CACHE_BLOB_ALIGNMENT) % SCENE_CACHE_BLOB_ALIGNMENT);
+    writeBytes(data, size);
+  }
+
+private:
+  void writeBytes(const void *data, std::size_t size)
+  {
+    m_Output.write(static_cast<const char *>(data), std::streamsize(size));
+    m_nOffset += size;
+  }
+
+  std::ofstream m_Output;
+  std::size_t m_nOffset = 0;
+};
+
+class CacheReader
+{
+public:
+  CacheReader(const unsigned char *data, std::size_t size) : m_pData(data), m_nSize(size) {}
+
+  template <typename T>
+  T read()
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be read");
+    T value;
+    std::memcpy(&value, readBytes(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string readString()
+  {
+    const auto size = read<uint32_t>();
+    return std::string(reinterpret_cast<const char *>(readBytes(size)), size);
+  }
+
+  template <typename T>
+  std::vector<T> readVector()
+  {
+    const auto count = read<uint32_t>();
+    std::vector<T> values(count);
+    std::memcpy(values.data(), readBytes(count * sizeof(T)), count * sizeof(T));
+    return values;
+  }
+
+  BufferBytes readBlob()
+  {
+    const auto size = read<uint64_t>();
+    readBytes((SCENE_CACHE_BLOB_ALIGNMENT - m_nOffset % SCENE_CACHE_BLOB_ALIGNMENT) % SCENE_CACHE_BLOB_ALIGNMENT);
+    return {readBytes(size), std::size_t(size)};
+  }
+
+private:
+  const unsigned char *readBytes(uint64_t size)
+  {
+    if (size > m_nSize - m_nOffset)
+    {
+      throw std::runtime_error("Truncated scene cache");
+    }
+    const auto *pBytes = m_pData + m_nOffset;
+    m_nOffset += std::size_t(size);
+    return pBytes;
+  }
+
+  const unsigned char *m_pData;
+  std::size_t m_nSize;
+  std::size_t m_nOffset = 0;
+};
+
+template <std::size_t N>
+void writeFloats(CacheWriter &writer, const std::vector<double> &values)
+{
+  for (std::size_t i = 0; i < N; ++i)
+  {
+    writer.write(float(values[i]));
+  }
+}
+
+template <std::size_t N>
+std::vector<double> readFloats(CacheReader &reader)
+{
+  std::vector<double> values(N);
+  for (auto &value : values)
+  {
+    value = reader.read<float>();
+  }
+  return values;
+}
+
+} // namespace
+
+fs::path getSceneCachePath(const fs::path &cacheDirectory, const fs::path &gltfFile)
+{
+  MappedFile file{gltfFile};
+  if (!file.isOpen())
+  {
+    return {};
+  }
+  ThreadPool pool;
+  const std::string version = GLTF_VIEWER_VERSION;
+  const auto key = hashBytes(reinterpret_cast<const unsigned char *>(version.data()), version.size(), hashFileContent(file, pool));
+
+  std::stringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << key << ".gltfcache";
+  return cacheDirectory / name.str();
+}
+
+bool loadSceneCache(const fs::path &cachePath, tinygltf::Model &model, GltfBuffers &buffers, SceneCache &cache, SceneGraph &sceneGraph,
+    PackedGeometry &geometry, std::vector<std::vector<Bounds>> &meshPrimitiveBounds)
+{
+  MappedFile file{cachePath};
+  if (!file.isOpen())
+  {
+    return false;
+  }
+
+  try
+  {
+    CacheReader reader{file.data(), file.size()};
+
+    const auto magic = reader.read<std::array<char, 8>>();
+    if (std::memcmp(magic.data(), SCENE_CACHE_MAGIC, sizeof(SCENE_CACHE_MAGIC)) != 0 ||
+        reader.read<uint32_t>() != SCENE_CACHE_FORMAT_VERSION || reader.readString() != GLTF_VIEWER_VERSION)
+    {
+      return false;
+    }
+
+    const auto dependencyCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < dependencyCount; ++i)
+    {
+      Dependency expected;
+      expected.path = reader.readString();
+      expected.size = reader.read<uint64_t>();
+      expected.modificationTime = reader.read<int64_t>();
+      Dependency current;
+      if (!getDependency(expected.path, current) || current.size != expected.size ||
+          current.modificationTime != expected.modificationTime)
+      {
+        return false;
+      }
+    }
+
+    model = tinygltf::Model{};
+    cache = SceneCache{};
+    geometry = PackedGeometry{};
+    meshPrimitiveBounds.clear();
+
+    // Primitives only keep what drawing reads, their geometry is packed
+    model.meshes.resize(reader.read<uint32_t>());
+    meshPrimitiveBounds.resize(model.meshes.size());
+    for (std::size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx)
+    {
+      auto &mesh = model.meshes[meshIdx];
+      mesh.name = reader.readString();
+      auto &primitives = mesh.primitives;
+      primitives.resize(reader.read<uint32_t>());
+      meshPrimitiveBounds[meshIdx].resize(primitives.size());
+      for (std::size_t primitiveIdx = 0; primitiveIdx < primitives.size(); ++primitiveIdx)
+      {
+        auto &primitive = primitives[primitiveIdx];
+        primitive.material = reader.read<int32_t>();
+        primitive.mode = reader.read<int32_t>();
+        meshPrimitiveBounds[meshIdx][primitiveIdx] = reader.read<Bounds>();
+      }
+    }
+
+    model.materials.resize(reader.read<uint32_t>());
+    for (auto &material : model.materials)
+    {
+      material.name = reader.readString();
+      auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+      pbrMetallicRoughness.baseColorFactor = readFloats<4>(reader);
+      pbrMetallicRoughness.metallicFactor = reader.read<float>();
+      pbrMetallicRoughness.roughnessFactor = reader.read<float>();
+      pbrMetallicRoughness.baseColorTexture.index = reader.read<int32_t>();
+      pbrMetallicRoughness.metallicRoughnessTexture.index = reader.read<int32_t>();
+      material.emissiveFactor = readFloats<3>(reader);
+      material.emissiveTexture.index = reader.read<int32_t>();
+      material.occlusionTexture.index = reader.read<int32_t>();
+      material.occlusionTexture.strength = reader.read<float>();
+      material.normalTexture.index = reader.read<int32_t>();
+      material.normalTexture.scale = reader.read<float>();
+      material.alphaMode = reader.readString();
+      material.alphaCutoff = reader.read<float>();
+      material.doubleSided = reader.read<uint8_t>() != 0;
+    }
+
+    model.samplers.resize(reader.read<uint32_t>());
+    for (auto &sampler : model.samplers)
+    {
+      sampler.minFilter = reader.read<int32_t>();
+      sampler.magFilter = reader.read<int32_t>();
+      sampler.wrapS = reader.read<int32_t>();
+      sampler.wrapT = reader.read<int32_t>();
+      sampler.wrapR = reader.read<int32_t>();
+    }
+
+    model.textures.resize(reader.read<uint32_t>());
+    for (auto &texture : model.textures)
+    {
+      texture.sampler = reader.read<int32_t>();
+      texture.source = reader.read<int32_t>();
+    }
+
+    model.images.resize(reader.read<uint32_t>());
+    cache.imagePixels.resize(model.images.size());
+    for (std::size_t imageIdx = 0; imageIdx < model.images.size(); ++imageIdx)
+    {
+      auto &image = model.images[imageIdx];
+      image.width = reader.read<int32_t>();
+      image.height = reader.read<int32_t>();
+      image.component = reader.read<int32_t>();
+      image.bits = reader.read<int32_t>();
+      image.pixel_type = reader.read<int32_t>();
+      auto &pixels = cache.imagePixels[imageIdx];
+      pixels = reader.readBlob();
+      if (pixels.size && pixels.size != uint64_t(image.width) * image.height * image.component * (image.bits / 8))
+      {
+        throw std::runtime_error("Invalid image size");
+      }
+    }
+
+    // Nodes are stored as a flat table of parent indices and local matrices
+    model.nodes.resize(reader.read<uint32_t>());
+    std::vector<int32_t> parents(model.nodes.size());
+    for (std::size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx)
+    {
+      auto &node = model.nodes[nodeIdx];
+      node.name = reader.readString();
+      parents[nodeIdx] = reader.read<int32_t>();
+      node.mesh = reader.read<int32_t>();
+      const auto localMatrix = reader.read<glm::mat4>();
+      node.matrix.assign(glm::value_ptr(localMatrix), glm::value_ptr(localMatrix) + 16);
+    }
+    for (std::size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx)
+    {
+      if (parents[nodeIdx] >= 0)
+      {
+        model.nodes.at(parents[nodeIdx]).children.emplace_back(int(nodeIdx));
+      }
+    }
+
+    model.scenes.resize(reader.read<uint32_t>());
+    for (auto &scene : model.scenes)
+    {
+      scene.nodes = reader.readVector<int>();
+    }
+    model.defaultScene = reader.read<int32_t>();
+
+    sceneGraph = SceneGraph{reader.readVector<SceneGraph::Node>()};
+
+    geometry.vertexPools.resize(reader.read<uint32_t>());
+    for (auto &pool : geometry.vertexPools)
+    {
+      pool.attributes = reader.read<std::array<PackedGeometry::Attribute, PackedGeometry::ATTRIBUTE_COUNT>>();
+      pool.stride = reader.read<uint32_t>();
+      pool.vertexCount = reader.read<uint32_t>();
+      pool.vertices = reader.readBlob();
+      if (pool.vertices.size != uint64_t(pool.vertexCount) * pool.stride)
+      {
+        throw std::runtime_error("Invalid vertex pool size");
+      }
+    }
+    geometry.indexSize = reader.read<uint32_t>();
+    geometry.indices = reader.readBlob();
+    geometry.meshPrimitiveRanges.resize(model.meshes.size());
+    for (auto &ranges : geometry.meshPrimitiveRanges)
+    {
+      ranges = reader.readVector<PackedGeometry::Range>();
+    }
+  } catch (const std::exception &e)
+  {
+    std::cerr << "Invalid scene cache " << cachePath << ": " << e.what() << std::endl;
+    return false;
+  }
+
+  buffers.mappedFiles.clear();
+  buffers.mappedFiles.emplace_back(std::move(file));
+
+  return true;
+}
+
+bool writeSceneCache(const fs::path &cachePath, const fs::path &gltfFile, const tinygltf::Model &model, const SceneGraph &sceneGraph,
+    const PackedGeometry &geometry, const std::vector<std::vector<Bounds>> &meshPrimitiveBounds, std::string &err)
+{
+  std::error_code error;
+  fs::create_directories(cachePath.parent_path(), error);
+
+  // Write in a temporary file renamed at the end, so that concurrent
+  // processes never map a partially written cache
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp" + std::to_string(std::random_device{}());
+
+  {
+    CacheWriter writer{tmpPath};
+    if (!writer.good())
+    {
+      err = "Unable to open " + tmpPath.string() + " for writing";
+      return false;
+    }
+
+    writer.write(SCENE_CACHE_MAGIC);
+    writer.write(SCENE_CACHE_FORMAT_VERSION);
+    writer.writeString(GLTF_VIEWER_VERSION);
+
+    const auto dependencies = getDependencies(gltfFile, model);
+    writer.write(uint32_t(dependencies.size()));
+    for (const auto &dependency : dependencies)
+    {
+      writer.writeString(dependency.path);
+      writer.write(dependency.size);
+      writer.write(dependency.modificationTime);
+    }
+
+    writer.write(uint32_t(model.meshes.size()));
+    for (std::size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx)
+    {
+      const auto &mesh = model.meshes[meshIdx];
+      writer.writeString(mesh.name);
+      writer.write(uint32_t(mesh.primitives.size()));
+      for (std::size_t primitiveIdx = 0; primitiveIdx < mesh.primitives.size(); ++primitiveIdx)
+      {
+        const auto &primitive = mesh.primitives[primitiveIdx];
+        writer.write(int32_t(primitive.material));
+        writer.write(int32_t(primitive.mode));
+        writer.write(meshPrimitiveBounds[meshIdx][primitiveIdx]);
+      }
+    }
+
+    writer.write(uint32_t(model.materials.size()));
+    for (const auto &material : model.materials)
+    {
+      writer.writeString(material.name);
+      const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+      writeFloats<4>(writer, pbrMetallicRoughness.baseColorFactor);
+      writer.write(float(pbrMetallicRoughness.metallicFactor));
+      writer.write(float(pbrMetallicRoughness.roughnessFactor));
+      writer.write(int32_t(pbrMetallicRoughness.baseColorTexture.index));
+      writer.write(int32_t(pbrMetallicRoughness.metallicRoughnessTexture.index));
+      writeFloats<3>(writer, material.emissiveFactor);
+      writer.write(int32_t(material.emissiveTexture.index));
+      writer.write(int32_t(material.occlusionTexture.index));
+      writer.write(float(material.occlusionTexture.strength));
+      writer.write(int32_t(material.normalTexture.index));
+      writer.write(float(material.normalTexture.scale));
+      writer.writeString(material.alphaMode);
+      writer.write(float(material.alphaCutoff));
+      writer.write(uint8_t(material.doubleSided));
+    }
+
+    writer.write(uint32_t(model.samplers.size()));
+    for (const auto &sampler : model.samplers)
+    {
+      writer.write(int32_t(sampler.minFilter));
+      writer.write(int32_t(sampler.magFilter));
+      writer.write(int32_t(sampler.wrapS));
+      writer.write(int32_t(sampler.wrapT));
+      writer.write(int32_t(sampler.wrapR));
+    }
+
+    writer.write(uint32_t(model.textures.size()));
+    for (const auto &texture : model.textures)
+    {
+      writer.write(int32_t(texture.sampler));
+      writer.write(int32_t(texture.source));
+    }
+
+    writer.write(uint32_t(model.images.size()));
+    for (const auto &image : model.images)
+    {
+      writer.write(int32_t(image.width));
+      writer.write(int32_t(image.height));
+      writer.write(int32_t(image.component));
+      writer.write(int32_t(image.bits));
+      writer.write(int32_t(image.pixel_type));
+      writer.writeBlob(image.image.data(), image.image.size());
+    }
+
+    std::vector<int32_t> parents(model.nodes.size(), -1);
+    for (std::size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx)
+    {
+      for (const auto child : model.nodes[nodeIdx].children)
+      {
+        parents[child] = int32_t(nodeIdx);
+      }
+    }
+    writer.write(uint32_t(model.nodes.size()));
+    for (std::size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx)
+    {
+      const auto &node = model.nodes[nodeIdx];
+      writer.writeString(node.name);
+      writer.write(parents[nodeIdx]);
+      writer.write(int32_t(node.mesh));
+      writer.write(getLocalToWorldMatrix(node, glm::mat4(1)));
+    }
+
+    writer.write(uint32_t(model.scenes.size()));
+    for (const auto &scene : model.scenes)
+    {
+      writer.writeVector(scene.nodes);
+    }
+    writer.write(int32_t(model.defaultScene));
+
+    writer.writeVector(sceneGraph.nodes());
+
+    writer.write(uint32_t(geometry.vertexPools.size()));
+    for (const auto &pool : geometry.vertexPools)
+    {
+      writer.write(pool.attributes);
+      writer.write(pool.stride);
+      writer.write(pool.vertexCount);
+      writer.writeBlob(pool.vertices.data, pool.vertices.size);
+    }
+    writer.write(geometry.indexSize);
+    writer.writeBlob(geometry.indices.data, geometry.indices.size);
+    for (const auto &ranges : geometry.meshPrimitiveRanges)
+    {
+      writer.writeVector(ranges);
+    }
+
+    if (!writer.good())
+    {
+      err = "Unable to write " + tmpPath.string();
+      fs::remove(tmpPath, error);
+      return false;
+    }
+  }
+
+  fs::rename(tmpPath, cachePath, error);
+  if (error)
+  {
+    err = "Unable to rename " + tmpPath.string() + ": " + error.message();
+    fs::remove(tmpPath, error);
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gltf.hpp"
+#include "packed_geometry.hpp"
+#include "scene_graph.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+// Data stored in the scene cache in addition to the model itself. Image
+// pixels point into the cache mapping, owned by the GltfBuffers the cache has
+// been loaded with.
+struct SceneCache
+{
+  std::vector<BufferBytes> imagePixels; // Indexed like model.images, empty if the image could not be decoded
+};
+
+// The scene cache stores a loaded glTF model in a binary file ready to be
+// memory mapped: decoded images, the node hierarchy as a flat table of local
+// matrices and parent indices, the flattened scene graph, the packed geometry,
+// the bounds of each primitive and the names of nodes, meshes and materials.
+// Loading it involves no JSON parsing, no image decoding, no bounds
+// computation and no geometry packing. Raw glTF buffers, buffer views and
+// accessors are not stored: everything drawn from them is in the packed
+// geometry. Mip levels are not stored either, they are generated on upload as
+// for a model loaded from its glTF file.
+//
+// Cache files are named after a hash of the content of the glTF file and of
+// the viewer version. External files (.bin, images) are validated with their
+// size and modification time.
+
+// Path of the cache file of gltfFile in cacheDirectory
+fs::path getSceneCachePath(const fs::path &cacheDirectory, const fs::path &gltfFile);
+
+// Load a scene cache written by writeSceneCache. model is filled as if
+// loadGltfModel() and decodeGltfImages() had been called, except that it has
+// no buffers, buffer views nor accessors, primitives have no attributes nor
+// indices, and image pixels are only available through cache.imagePixels.
+// Vertices and indices of geometry point into the cache mapping, owned by
+// buffers, whose bytes are empty. Return false if the cache does not exist,
+// is outdated or invalid.
+bool loadSceneCache(const fs::path &cachePath, tinygltf::Model &model, GltfBuffers &buffers, SceneCache &cache, SceneGraph &sceneGraph,
+    PackedGeometry &geometry, std::vector<std::vector<Bounds>> &meshPrimitiveBounds);
+
+// Write the cache of a model loaded from gltfFile with decoded images, the
+// graph of its default scene, its packed geometry and the bounds of its
+// primitives, see computePrimitiveBounds().
+bool writeSceneCache(const fs::path &cachePath, const fs::path &gltfFile, const tinygltf::Model &model, const SceneGraph &sceneGraph,
+    const PackedGeometry &geometry, const std::vector<std::vector<Bounds>> &meshPrimitiveBounds, std::string &err);
@@ -0,0 +1,331 @@
+#include "scene_generator.hpp"
+
+#include <stb_image_write.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The output of std::mt19937 is specified by the standard, unlike the
+// distributions of <random>, so values are derived from it directly
+class Random
+{
+public:
+  explicit Random(uint32_t seed) : m_Generator(seed) {}
+
+  float uniform(float min, float max) { return min + (max - min) * float(m_Generator() >> 8) * (1.f / 16777216.f); }
+
+private:
+  std::mt19937 m_Generator;
+};
+
+// Append a bufferView of size bytes to the buffer, padded so that the next
+// one starts on a 4 bytes boundary. Return its index.
+int addBufferView(tinygltf::Model &model, const void *data, size_t size, int target)
+{
+  auto &bytes = model.buffers[0].data;
+  tinygltf::BufferView bufferView;
+  bufferView.buffer = 0;
+  bufferView.byteOffset = bytes.size();
+  bufferView.byteLength = size;
+  bufferView.target = target;
+  bytes.insert(end(bytes), static_cast<const unsigned char *>(data), static_cast<const unsigned char *>(data) + size);
+  bytes.resize((bytes.size() + 3) & ~size_t(3));
+  model.bufferViews.push_back(bufferView);
+  return int(model.bufferViews.size()) - 1;
+}
+
+int addAccessor(tinygltf::Model &model, int bufferView, int componentType, int type, size_t count)
+{
+  tinygltf::Accessor accessor;
+  accessor.bufferView = bufferView;
+  accessor.componentType = componentType;
+  accessor.type = type;
+  accessor.count = count;
+  model.accessors.push_back(accessor);
+  return int(model.accessors.size()) - 1;
+}
+
+template <typename Index> std::vector<unsigned char> makeIndices(uint32_t gridSize)
+{
+  std::vector<Index> indices;
+  indices.reserve(size_t(gridSize) * gridSize * 6);
+  const auto rowSize = gridSize + 1;
+  for (uint32_t z = 0; z < gridSize; ++z)
+  {
+    for (uint32_t x = 0; x < gridSize; ++x)
+    {
+      const auto i = z * rowSize + x;
+      for (const auto index : {i, i + rowSize, i + 1, i + 1, i + rowSize, i + rowSize + 1})
+      {
+        indices.push_back(Index(index));
+      }
+    }
+  }
+  std::vector<unsigned char> bytes(indices.size() * sizeof(Index));
+  std::memcpy(bytes.data(), indices.data(), bytes.size());
+  return bytes;
+}
+
+// Height field y = a sin(fx x + px) cos(fz z + pz) on [-1, 1]^2, with a grid
+// of gridSize x gridSize quads
+void addMesh(tinygltf::Model &model, const SceneGeneratorOptions &options, uint32_t gridSize, int material, Random &random)
+{
+  const auto amplitude = random.uniform(0.05f, 0.5f);
+  const auto frequency = glm::vec2(random.uniform(1.f, 8.f), random.uniform(1.f, 8.f));
+  const auto phase = glm::vec2(random.uniform(0.f, 6.28f), random.uniform(0.f, 6.28f));
+
+  const auto rowSize = gridSize + 1;
+  const auto vertexCount = size_t(rowSize) * rowSize;
+  std::vector<glm::vec3> positions, normals;
+  std::vector<glm::vec2> texCoords;
+  positions.reserve(vertexCount);
+  normals.reserve(vertexCount);
+  texCoords.reserve(vertexCount);
+  auto bboxMin = glm::vec3(std::numeric_limits<float>::max());
+  auto bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (uint32_t z = 0; z < rowSize; ++z)
+  {
+    for (uint32_t x = 0; x < rowSize; ++x)
+    {
+      const auto uv = glm::vec2(x, z) / float(gridSize);
+      const auto xz = uv * 2.f - 1.f;
+      const auto angles = frequency * xz + phase;
+      const auto position = glm::vec3(xz.x, amplitude * std::sin(angles.x) * std::cos(angles.y), xz.y);
+      const auto dydx = amplitude * frequency.x * std::cos(angles.x) * std::cos(angles.y);
+      const auto dydz = -amplitude * frequency.y * std::sin(angles.x) * std::sin(angles.y);
+      positions.push_back(position);
+      normals.push_back(glm::normalize(glm::vec3(-dydx, 1.f, -dydz)));
+      texCoords.push_back(uv);
+      bboxMin = glm::min(bboxMin, position);
+      bboxMax = glm::max(bboxMax, position);
+    }
+  }
+
+  tinygltf::Primitive primitive;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  primitive.material = material;
+  primitive.attributes["POSITION"] =
+      addAccessor(model, addBufferView(model, positions.data(), positions.size() * sizeof(glm::vec3), TINYGLTF_TARGET_ARRAY_BUFFER),
+          TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertexCount);
+  model.accessors.back().minValues = {bboxMin.x, bboxMin.y, bboxMin.z};
+  model.accessors.back().maxValues = {bboxMax.x, bboxMax.y, bboxMax.z};
+  primitive.attributes["NORMAL"] =
+      addAccessor(model, addBufferView(model, normals.data(), normals.size() * sizeof(glm::vec3), TINYGLTF_TARGET_ARRAY_BUFFER),
+          TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertexCount);
+  primitive.attributes["TEXCOORD_0"] =
+      addAccessor(model, addBufferView(model, texCoords.data(), texCoords.size() * sizeof(glm::vec2), TINYGLTF_TARGET_ARRAY_BUFFER),
+          TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, vertexCount);
+
+  std::vector<unsigned char> indices;
+  int componentType = 0;
+  switch (options.indexWidth)
+  {
+  case 8:
+    indices = makeIndices<uint8_t>(gridSize);
+    componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    break;
+  case 16:
+    indices = makeIndices<uint16_t>(gridSize);
+    componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+    break;
+  default:
+    indices = makeIndices<uint32_t>(gridSize);
+    componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+  }
+  primitive.indices = addAccessor(model, addBufferView(model, indices.data(), indices.size(), TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER),
+      componentType, TINYGLTF_TYPE_SCALAR, size_t(gridSize) * gridSize * 6);
+
+  tinygltf::Mesh mesh;
+  mesh.name = "mesh" + std::to_string(model.meshes.size());
+  mesh.primitives.push_back(std::move(primitive));
+  model.meshes.push_back(std::move(mesh));
+}
+
+void appendBytes(void *context, void *data, int size)
+{
+  auto &bytes = *static_cast<std::vector<unsigned char> *>(context);
+  bytes.insert(end(bytes), static_cast<unsigned char *>(data), static_cast<unsigned char *>(data) + size);
+}
+
+// Checkerboard of two random colors with noise, encoded in PNG
+void addTexture(tinygltf::Model &model, uint32_t size, Random &random)
+{
+  const auto colors = std::array<glm::vec3, 2>{
+      glm::vec3(random.uniform(0, 255), random.uniform(0, 255), random.uniform(0, 255)),
+      glm::vec3(random.uniform(0, 255), random.uniform(0, 255), random.uniform(0, 255))};
+  const auto cellSize = std::max(size / 8, 1u);
+  std::vector<unsigned char> pixels(size_t(size) * size * 3);
+  for (uint32_t y = 0; y < size; ++y)
+  {
+    for (uint32_t x = 0; x < size; ++x)
+    {
+      const auto &color = colors[(x / cellSize + y / cellSize) % 2];
+      for (int c = 0; c < 3; ++c)
+      {
+        pixels[(size_t(y) * size + x) * 3 + c] = (unsigned char)glm::clamp(color[c] + random.uniform(-8.f, 8.f), 0.f, 255.f);
+      }
+    }
+  }
+  std::vector<unsigned char> png;
+  stbi_write_png_to_func(appendBytes, &png, int(size), int(size), 3, pixels.data(), int(size) * 3);
+
+  tinygltf::Image image;
+  image.name = "texture" + std::to_string(model.images.size());
+  image.mimeType = "image/png";
+  image.bufferView = addBufferView(model, png.data(), png.size(), 0);
+  model.images.push_back(std::move(image));
+
+  tinygltf::Texture texture;
+  texture.source = int(model.images.size()) - 1;
+  texture.sampler = 0;
+  model.textures.push_back(texture);
+}
+
+void addMaterial(tinygltf::Model &model, int texture, Random &random)
+{
+  tinygltf::Material material;
+  material.name = "material" + std::to_string(model.materials.size());
+  material.pbrMetallicRoughness.baseColorFactor = {
+      random.uniform(0.2f, 1.f), random.uniform(0.2f, 1.f), random.uniform(0.2f, 1.f), 1.};
+  material.pbrMetallicRoughness.metallicFactor = random.uniform(0.f, 1.f);
+  material.pbrMetallicRoughness.roughnessFactor = random.uniform(0.1f, 1.f);
+  material.pbrMetallicRoughness.baseColorTexture.index = texture;
+  model.materials.push_back(std::move(material));
+}
+
+} // namespace
+
+bool generateModel(const SceneGeneratorOptions &options, tinygltf::Model &model, std::string &err)
+{
+  if (options.nodeCount == 0 || options.depth == 0 || options.instancesPerMesh == 0)
+  {
+    err = "node count, depth and instances per mesh must be positive";
+    return false;
+  }
+  if (options.indexWidth != 8 && options.indexWidth != 16 && options.indexWidth != 32)
+  {
+    err = "index width must be 8, 16 or 32 bits";
+    return false;
+  }
+  // A grid of n x n quads has 2 n^2 triangles and (n + 1)^2 vertices
+  const auto gridSize = std::max(uint32_t(std::lround(std::sqrt(options.trianglesPerMesh / 2.))), 1u);
+  const auto vertexCount = (uint64_t(gridSize) + 1) * (gridSize + 1);
+  // glTF reserves the maximum value of the index type for primitive restart
+  if (options.indexWidth < 32 && vertexCount >= (uint64_t(1) << options.indexWidth))
+  {
+    err = std::to_string(vertexCount) + " vertices per mesh do not fit in " + std::to_string(options.indexWidth) + " bits indices";
+    return false;
+  }
+
+  Random random{options.seed};
+  model = tinygltf::Model{};
+  model.asset.version = "2.0";
+  model.asset.generator = "gltf-viewer generate";
+  model.buffers.resize(1);
+
+  tinygltf::Sampler sampler;
+  sampler.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+  sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+  model.samplers.push_back(sampler);
+  for (uint32_t i = 0; i < options.textureCount; ++i)
+  {
+    addTexture(model, std::max(options.textureSize, 1u), random);
+  }
+  for (uint32_t i = 0; i < options.materialCount; ++i)
+  {
+    addMaterial(model, options.textureCount > 0 ? int(i % options.textureCount) : -1, random);
+  }
+
+  const auto meshCount = (options.nodeCount + options.instancesPerMesh - 1) / options.instancesPerMesh;
+  for (uint32_t i = 0; i < meshCount; ++i)
+  {
+    addMesh(model, options, gridSize, options.materialCount > 0 ? int(i % options.materialCount) : -1, random);
+  }
+
+  // Smallest number of children per node (and of roots) such that depth
+  // levels hold all nodes. Nodes are numbered level by level: the children of
+  // node p are nodes (p + 1) * b to (p + 2) * b - 1.
+  uint64_t branching = 1;
+  for (;; ++branching)
+  {
+    double capacity = 0, levelSize = 1;
+    for (uint32_t level = 0; level < options.depth && capacity < options.nodeCount; ++level)
+    {
+      levelSize *= double(branching);
+      capacity += levelSize;
+    }
+    if (capacity >= options.nodeCount)
+    {
+      break;
+    }
+  }
+
+  // Siblings are laid out on a grid whose cells contain the grids of their
+  // subtrees, meshes covering [-1, 1]^2
+  const auto gridSide = uint32_t(std::ceil(std::sqrt(double(branching))));
+  std::vector<uint32_t> levels(options.nodeCount, 0);
+  model.nodes.resize(options.nodeCount);
+  model.scenes.resize(1);
+  for (uint32_t i = 0; i < options.nodeCount; ++i)
+  {
+    auto &node = model.nodes[i];
+    node.name = "node" + std::to_string(i);
+    node.mesh = int(i % meshCount);
+
+    const auto siblingIdx = uint32_t(i % branching);
+    if (i < branching)
+    {
+      model.scenes[0].nodes.push_back(int(i));
+    } else
+    {
+      const auto parent = size_t(i / branching - 1);
+      levels[i] = levels[parent] + 1;
+      model.nodes[parent].children.push_back(int(i));
+    }
+    const auto spacing = 2.5 * std::pow(double(gridSide), double(options.depth - 1 - levels[i]));
+    const auto cell = glm::dvec2(siblingIdx % gridSide, siblingIdx / gridSide) - 0.5 * (gridSide - 1);
+    const auto rotation = glm::angleAxis(random.uniform(-0.3f, 0.3f), glm::vec3(0, 1, 0));
+    node.translation = {cell.x * spacing, levels[i] > 0 ? 0.5 : 0., cell.y * spacing};
+    node.rotation = {rotation.x, rotation.y, rotation.z, rotation.w};
+  }
+  model.defaultScene = 0;
+  return true;
+}
+
+bool generateScene(const fs::path &path, const SceneGeneratorOptions &options, std::string &err)
+{
+  tinygltf::Model model;
+  if (!generateModel(options, model, err))
+  {
+    return false;
+  }
+
+  auto extension = path.extension().string();
+  std::transform(begin(extension), end(extension), begin(extension), [](unsigned char c) { return char(std::tolower(c)); });
+  const auto binary = extension == ".glb";
+  if (!binary)
+  {
+    model.buffers[0].uri = path.stem().string() + ".bin";
+  }
+
+  tinygltf::TinyGLTF writer;
+  // Images are already encoded in bufferViews, nothing to write for them
+  writer.SetImageWriter([](const std::string *, const std::string *, tinygltf::Image *, bool, void *) { return true; }, nullptr);
+  if (!writer.WriteGltfSceneToFile(&model, path.string(), false, false, !binary, binary))
+  {
+    err = "unable to write " + path.string();
+    return false;
+  }
+  return true;
+}
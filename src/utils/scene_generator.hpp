@@ -0,0 +1,36 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <string>
+
+// Parameters of a synthetic scene, see generateModel()
+struct SceneGeneratorOptions
+{
+  uint32_t nodeCount = 1000;
+  uint32_t depth = 4;            // Levels of the node hierarchy, 1 for a flat scene
+  uint32_t instancesPerMesh = 4; // Nodes sharing each mesh
+  uint32_t trianglesPerMesh = 5000;
+  uint32_t materialCount = 16; // 0 for the default material
+  uint32_t textureCount = 8;
+  uint32_t textureSize = 512;
+  uint32_t indexWidth = 32; // Bits per index: 8, 16 or 32
+  uint32_t seed = 1;
+};
+
+// Generate a deterministic scene: the same options give the same model on
+// all platforms. Nodes form a tree of options.depth levels with the same
+// number of children per node, each node instancing a mesh. Meshes are
+// height fields of about trianglesPerMesh triangles with positions, normals
+// and texture coordinates, each using one material. Materials use textures
+// as base color, round robin; textures are PNG images stored in the buffer.
+// Return false and set err if options are invalid.
+bool generateModel(const SceneGeneratorOptions &options, tinygltf::Model &model, std::string &err);
+
+// Generate a model and write it as .glb if path has this extension, otherwise
+// as .gltf with its buffer in a .bin file next to it. Return false and set
+// err if options are invalid or the file cannot be written.
+bool generateScene(const fs::path &path, const SceneGeneratorOptions &options, std::string &err);
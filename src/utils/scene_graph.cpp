@@ -0,0 +1,184 @@
+#include "scene_graph.hpp"
+#include "gltf.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+glm::mat4 composeMatrix(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+  return glm::scale(glm::translate(glm::mat4(1), translation) * glm::mat4_cast(rotation), scale);
+}
+
+// Inverse of composeMatrix() for matrices without shear nor projection. A
+// negative determinant is carried by the scale on x.
+void decomposeMatrix(const glm::mat4 &matrix, glm::vec3 &translation, glm::quat &rotation, glm::vec3 &scale)
+{
+  const auto linear = glm::mat3(matrix);
+  translation = glm::vec3(matrix[3]);
+  scale = glm::vec3(glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+  if (glm::determinant(linear) < 0.f)
+  {
+    scale.x = -scale.x;
+  }
+  if (scale.x == 0.f || scale.y == 0.f || scale.z == 0.f)
+  {
+    rotation = glm::quat(1, 0, 0, 0);
+    return;
+  }
+  rotation = glm::normalize(glm::quat_cast(glm::mat3(linear[0] / scale.x, linear[1] / scale.y, linear[2] / scale.z)));
+}
+
+} // namespace
+
+SceneGraph::SceneGraph(const tinygltf::Model &model, int sceneIdx)
+{
+  if (sceneIdx < 0)
+  {
+    return;
+  }
+
+  // Explicit stack instead of recursion, some CAD exports have very deep
+  // hierarchies. Pairs of (glTF node index, parent index in m_Nodes).
+  std::vector<std::pair<int, int>> stack;
+  const auto &rootNodes = model.scenes[sceneIdx].nodes;
+  for (auto it = rootNodes.rbegin(); it != rootNodes.rend(); ++it)
+  {
+    stack.emplace_back(*it, -1);
+  }
+
+  while (!stack.empty())
+  {
+    const auto gltfNodeIdx = stack.back().first;
+    const auto parentIdx = stack.back().second;
+    stack.pop_back();
+
+    const auto &gltfNode = model.nodes[gltfNodeIdx];
+    const auto nodeIdx = int(m_Nodes.size());
+    Node node{parentIdx, nodeIdx + 1, gltfNodeIdx, gltfNode.mesh, glm::vec3(0), glm::quat(1, 0, 0, 0), glm::vec3(1),
+        getLocalToWorldMatrix(gltfNode, glm::mat4(1)), glm::mat4(1), glm::mat3(1)};
+    if (!gltfNode.matrix.empty())
+    {
+      decomposeMatrix(node.localMatrix, node.translation, node.rotation, node.scale);
+    } else
+    {
+      if (!gltfNode.translation.empty())
+      {
+        node.translation = glm::vec3(gltfNode.translation[0], gltfNode.translation[1], gltfNode.translation[2]);
+      }
+      if (!gltfNode.rotation.empty())
+      {
+        // glTF stores x, y, z, w
+        node.rotation = glm::quat(float(gltfNode.rotation[3]), float(gltfNode.rotation[0]), float(gltfNode.rotation[1]),
+            float(gltfNode.rotation[2]));
+      }
+      if (!gltfNode.scale.empty())
+      {
+        node.scale = glm::vec3(gltfNode.scale[0], gltfNode.scale[1], gltfNode.scale[2]);
+      }
+    }
+    m_Nodes.push_back(node);
+    if (gltfNode.mesh >= 0)
+    {
+      m_MeshNodes.emplace_back(nodeIdx);
+    }
+    if (parentIdx < 0)
+    {
+      m_DirtyNodes.emplace_back(nodeIdx);
+    }
+
+    for (auto it = gltfNode.children.rbegin(); it != gltfNode.children.rend(); ++it)
+    {
+      stack.emplace_back(*it, nodeIdx);
+    }
+  }
+
+  // In depth-first order, the subtree of a node ends where the subtree of
+  // its last child ends
+  for (auto nodeIdx = int(m_Nodes.size()) - 1; nodeIdx >= 0; --nodeIdx)
+  {
+    const auto &node = m_Nodes[nodeIdx];
+    if (node.parent >= 0)
+    {
+      auto &parent = m_Nodes[node.parent];
+      parent.subtreeEnd = std::max(parent.subtreeEnd, node.subtreeEnd);
+    }
+  }
+
+  updateWorldMatrices();
+}
+
+SceneGraph::SceneGraph(std::vector<Node> nodes) : m_Nodes(std::move(nodes))
+{
+  for (size_t nodeIdx = 0; nodeIdx < m_Nodes.size(); ++nodeIdx)
+  {
+    if (m_Nodes[nodeIdx].mesh >= 0)
+    {
+      m_MeshNodes.emplace_back(int(nodeIdx));
+    }
+  }
+}
+
+void SceneGraph::setTranslation(int nodeIdx, const glm::vec3 &translation)
+{
+  m_Nodes[nodeIdx].translation = translation;
+  updateLocalMatrix(nodeIdx);
+}
+
+void SceneGraph::setRotation(int nodeIdx, const glm::quat &rotation)
+{
+  m_Nodes[nodeIdx].rotation = rotation;
+  updateLocalMatrix(nodeIdx);
+}
+
+void SceneGraph::setScale(int nodeIdx, const glm::vec3 &scale)
+{
+  m_Nodes[nodeIdx].scale = scale;
+  updateLocalMatrix(nodeIdx);
+}
+
+void SceneGraph::setLocalMatrix(int nodeIdx, const glm::mat4 &localMatrix)
+{
+  auto &node = m_Nodes[nodeIdx];
+  node.localMatrix = localMatrix;
+  decomposeMatrix(localMatrix, node.translation, node.rotation, node.scale);
+  m_DirtyNodes.emplace_back(nodeIdx);
+}
+
+void SceneGraph::updateLocalMatrix(int nodeIdx)
+{
+  auto &node = m_Nodes[nodeIdx];
+  node.localMatrix = composeMatrix(node.translation, node.rotation, node.scale);
+  m_DirtyNodes.emplace_back(nodeIdx);
+}
+
+void SceneGraph::updateWorldMatrices()
+{
+  if (m_DirtyNodes.empty())
+  {
+    return;
+  }
+
+  // Processing dirty nodes in order allows skipping those that are in the
+  // subtree of a node already updated
+  std::sort(begin(m_DirtyNodes), end(m_DirtyNodes));
+  auto updatedEnd = 0;
+  for (const auto dirtyNodeIdx : m_DirtyNodes)
+  {
+    if (dirtyNodeIdx < updatedEnd)
+    {
+      continue;
+    }
+    updatedEnd = m_Nodes[dirtyNodeIdx].subtreeEnd;
+    for (auto nodeIdx = dirtyNodeIdx; nodeIdx < updatedEnd; ++nodeIdx)
+    {
+      auto &node = m_Nodes[nodeIdx];
+      node.worldMatrix = node.parent >= 0 ? m_Nodes[node.parent].worldMatrix * node.localMatrix : node.localMatrix;
+      node.worldNormalMatrix = glm::transpose(glm::inverse(glm::mat3(node.worldMatrix)));
+    }
+  }
+  m_DirtyNodes.clear();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <tiny_gltf.h>
+
+#include <vector>
+
+// Nodes of a glTF scene flattened in depth-first order: a parent is stored
+// before its children and its descendants are stored contiguously right after
+// it. World matrices are cached and only recomputed for the subtrees of nodes
+// whose local transform changed since the last call to updateWorldMatrices().
+class SceneGraph
+{
+public:
+  struct Node
+  {
+    int parent;     // Index in nodes(), -1 for root nodes
+    int subtreeEnd; // Index following the last descendant of the node
+    int gltfNode;   // Index in model.nodes
+    int mesh;       // Index in model.meshes, -1 if no mesh
+    // Local transform, localMatrix is composed from it unless it was given
+    // as a matrix, in which case it is decomposed from localMatrix
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+    glm::mat4 localMatrix;
+    glm::mat4 worldMatrix;
+    glm::mat3 worldNormalMatrix; // transpose(inverse(worldMatrix)), for normals
+  };
+
+  SceneGraph() = default;
+
+  // Flatten the hierarchy of model.scenes[sceneIdx]. The graph is empty if
+  // sceneIdx is negative.
+  SceneGraph(const tinygltf::Model &model, int sceneIdx);
+
+  // Nodes already flattened, with their world matrices, as stored by the
+  // scene cache
+  explicit SceneGraph(std::vector<Node> nodes);
+
+  const std::vector<Node> &nodes() const { return m_Nodes; }
+
+  // Indices in nodes() of the nodes having a mesh, in increasing order
+  const std::vector<int> &meshNodes() const { return m_MeshNodes; }
+
+  // Setters of the local transform of a node, its subtree is updated by the
+  // next call to updateWorldMatrices()
+  void setTranslation(int nodeIdx, const glm::vec3 &translation);
+  void setRotation(int nodeIdx, const glm::quat &rotation);
+  void setScale(int nodeIdx, const glm::vec3 &scale);
+  void setLocalMatrix(int nodeIdx, const glm::mat4 &localMatrix);
+
+  // Recompute world matrices of the subtrees whose root has been modified
+  void updateWorldMatrices();
+
+private:
+  void updateLocalMatrix(int nodeIdx);
+
+  std::vector<Node> m_Nodes;
+  std::vector<int> m_MeshNodes;
+  std::vector<int> m_DirtyNodes;
+};
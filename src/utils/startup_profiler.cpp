@@ -0,0 +1,84 @@
+#include "startup_profiler.hpp"
+
+#include <json.hpp>
+
+#include <cassert>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// CPU time consumed by all threads of the process, in milliseconds
+static double getProcessCpuMilliseconds()
+{
+#ifdef _WIN32
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+  const auto toUnits = [](const FILETIME &time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+  return double(toUnits(kernelTime) + toUnits(userTime)) * 1e-4; // 100ns units
+#else
+  timespec time;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return double(time.tv_sec) * 1e3 + double(time.tv_nsec) * 1e-6;
+#endif
+}
+
+StartupProfiler::StartupProfiler(const fs::path &outputPath, const char *initialPhase) :
+    m_OutputPath{outputPath}, m_StartTime{std::chrono::steady_clock::now()}
+{
+  if (initialPhase)
+  {
+    beginPhase(initialPhase);
+  }
+}
+
+void StartupProfiler::beginPhase(const char *name)
+{
+  if (!enabled())
+  {
+    return;
+  }
+  assert(m_CurrentPhase.empty() && "Startup phases cannot be nested");
+  m_CurrentPhase = name;
+  m_PhaseCpuStart = getProcessCpuMilliseconds();
+  m_PhaseWallStart = std::chrono::steady_clock::now();
+}
+
+void StartupProfiler::endPhase(uint64_t bytes)
+{
+  if (!enabled())
+  {
+    return;
+  }
+  const auto wallEnd = std::chrono::steady_clock::now();
+  const auto cpuEnd = getProcessCpuMilliseconds();
+  m_Phases.push_back({m_CurrentPhase, std::chrono::duration<double, std::milli>(wallEnd - m_PhaseWallStart).count(),
+      cpuEnd - m_PhaseCpuStart, bytes});
+  m_CurrentPhase.clear();
+}
+
+bool StartupProfiler::write() const
+{
+  if (!enabled())
+  {
+    return true;
+  }
+
+  nlohmann::json phases = nlohmann::json::array();
+  for (const auto &phase : m_Phases)
+  {
+    phases.push_back(
+        {{"name", phase.name}, {"wall_ms", phase.wallMilliseconds}, {"cpu_ms", phase.cpuMilliseconds}, {"bytes", phase.bytes}});
+  }
+  const nlohmann::json profile = {
+      {"phases", phases}, {"total_wall_ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_StartTime).count()}};
+
+  std::ofstream output{m_OutputPath.string()};
+  output << profile.dump(2) << std::endl;
+  return bool(output);
+}
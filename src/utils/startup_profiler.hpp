@@ -0,0 +1,64 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Records wall time, CPU time (of all threads of the process) and number of
+// bytes processed by each phase of the application startup, and writes them
+// in a JSON file. All methods are no-ops when the profiler is disabled (empty
+// output path).
+class StartupProfiler
+{
+public:
+  // If initialPhase is not null, the phase begins immediately. This allows
+  // profiling the construction of class members declared after the profiler.
+  StartupProfiler(const fs::path &outputPath, const char *initialPhase = nullptr);
+
+  bool enabled() const { return !m_OutputPath.empty(); }
+
+  void beginPhase(const char *name);
+
+  void endPhase(uint64_t bytes = 0);
+
+  // Write recorded phases to the output path. Return false on IO error.
+  bool write() const;
+
+private:
+  struct Phase
+  {
+    std::string name;
+    double wallMilliseconds;
+    double cpuMilliseconds;
+    uint64_t bytes;
+  };
+
+  fs::path m_OutputPath;
+  std::chrono::steady_clock::time_point m_StartTime;
+
+  std::vector<Phase> m_Phases;
+  std::string m_CurrentPhase;
+  std::chrono::steady_clock::time_point m_PhaseWallStart;
+  double m_PhaseCpuStart = 0;
+};
+
+// Profile a phase lasting until the end of the current scope. bytes can be
+// updated in the scope.
+class ScopedStartupPhase
+{
+public:
+  ScopedStartupPhase(StartupProfiler &profiler, const char *name) : m_Profiler(profiler) { m_Profiler.beginPhase(name); }
+
+  ~ScopedStartupPhase() { m_Profiler.endPhase(bytes); }
+
+  ScopedStartupPhase(const ScopedStartupPhase &) = delete;
+  ScopedStartupPhase &operator=(const ScopedStartupPhase &) = delete;
+
+  uint64_t bytes = 0;
+
+private:
+  StartupProfiler &m_Profiler;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Minimum, maximum, mean and percentiles (nearest rank) of values, as
+// {"min": ..., "median": ..., "p95": ..., "p99": ..., "max": ..., "mean": ...}.
+// null if values is empty.
+template <typename T> nlohmann::json summarize(std::vector<T> values)
+{
+  if (values.empty())
+  {
+    return nullptr;
+  }
+  std::sort(begin(values), end(values));
+  const auto percentile = [&](double p) { return values[std::size_t(std::ceil(p * values.size())) - 1]; };
+  double sum = 0;
+  for (const auto value : values)
+  {
+    sum += double(value);
+  }
+  return {{"min", values.front()}, {"median", percentile(0.5)}, {"p95", percentile(0.95)}, {"p99", percentile(0.99)},
+      {"max", values.back()}, {"mean", sum / values.size()}};
+}
@@ -0,0 +1,94 @@
+#include "thread_pool.hpp"
+#include "tracing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+ThreadPool::ThreadPool(std::size_t threadCount)
+{
+  if (threadCount == 0)
+  {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  m_Workers.reserve(threadCount);
+  for (std::size_t i = 0; i < threadCount; ++i)
+  {
+    m_Workers.emplace_back([this, i]() {
+      setTraceThreadName("pool worker " + std::to_string(i));
+      workerLoop();
+    });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock{m_Mutex};
+    m_bStopping = true;
+  }
+  m_Condition.notify_all();
+  for (auto &worker : m_Workers)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)> &task)
+{
+  // Each worker pulls indices from a shared counter, so that uneven tasks
+  // (e.g. images of different sizes) are balanced between threads
+  std::atomic<std::size_t> nextIndex{0};
+  const auto chunkCount = std::min(count, threadCount());
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(chunkCount);
+  for (std::size_t i = 0; i < chunkCount; ++i)
+  {
+    futures.emplace_back(push([&]() {
+      for (auto index = nextIndex++; index < count; index = nextIndex++)
+      {
+        task(index);
+      }
+    }));
+  }
+
+  // Wait for all chunks before rethrowing, since they reference locals
+  std::exception_ptr exception;
+  for (auto &future : futures)
+  {
+    try
+    {
+      future.get();
+    } catch (...)
+    {
+      if (!exception)
+      {
+        exception = std::current_exception();
+      }
+    }
+  }
+  if (exception)
+  {
+    std::rethrow_exception(exception);
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  for (;;)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock{m_Mutex};
+      m_Condition.wait(lock, [this]() { return m_bStopping || !m_Tasks.empty(); });
+      if (m_Tasks.empty())
+      {
+        return;
+      }
+      task = std::move(m_Tasks.front());
+      m_Tasks.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO queue of tasks
+class ThreadPool
+{
+public:
+  // A threadCount of 0 means one thread per hardware thread
+  explicit ThreadPool(std::size_t threadCount = 0);
+
+  // Wait for queued tasks to complete, then join workers
+  ~ThreadPool();
+
+  // Non-copyable class:
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  std::size_t threadCount() const { return m_Workers.size(); }
+
+  // Queue a task. Exceptions thrown by the task are rethrown by the get()
+  // method of the returned future.
+  template <typename Function>
+  auto push(Function &&task) -> std::future<typename std::result_of<Function()>::type>
+  {
+    using Result = typename std::result_of<Function()>::type;
+    const auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(task));
+    auto future = packagedTask->get_future();
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      m_Tasks.emplace([packagedTask]() { (*packagedTask)(); });
+    }
+    m_Condition.notify_one();
+    return future;
+  }
+
+  // Call task(i) for each i in [0, count) using all workers and return when
+  // all calls are done. The first exception thrown by a call is rethrown.
+  void parallelFor(std::size_t count, const std::function<void(std::size_t)> &task);
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> m_Workers;
+  std::queue<std::function<void()>> m_Tasks;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  bool m_bStopping = false;
+};
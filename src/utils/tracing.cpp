@@ -0,0 +1,119 @@
+#include "tracing.hpp"
+
+#include <json.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const size_t ZONES_PER_THREAD = 1 << 16;
+
+struct Zone
+{
+  const char *name;
+  uint64_t beginTime;
+  uint64_t endTime;
+};
+
+// Written by its thread only, read by writeTrace()
+struct ThreadBuffer
+{
+  uint32_t threadId;
+  std::string threadName;
+  std::vector<Zone> zones; // Ring of ZONES_PER_THREAD zones
+  uint64_t zoneCount = 0;  // Recorded since the start, including overwritten ones
+};
+
+std::chrono::steady_clock::time_point g_StartTime = std::chrono::steady_clock::now();
+
+// Buffers are shared with the registry, so that zones of finished threads are
+// kept until the trace is written
+std::mutex g_RegistryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_Registry;
+
+ThreadBuffer &getThreadBuffer()
+{
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer)
+  {
+    buffer = std::make_shared<ThreadBuffer>();
+    buffer->zones.resize(ZONES_PER_THREAD);
+    std::lock_guard<std::mutex> lock{g_RegistryMutex};
+    buffer->threadId = uint32_t(g_Registry.size());
+    buffer->threadName = buffer->threadId == 0 ? "main" : "thread " + std::to_string(buffer->threadId);
+    g_Registry.push_back(buffer);
+  }
+  return *buffer;
+}
+
+} // namespace
+
+namespace tracing {
+
+std::atomic<bool> g_Enabled{false};
+
+uint64_t now()
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_StartTime).count());
+}
+
+void recordZone(const char *name, uint64_t beginTime, uint64_t endTime)
+{
+  auto &buffer = getThreadBuffer();
+  buffer.zones[buffer.zoneCount++ % ZONES_PER_THREAD] = {name, beginTime, endTime};
+}
+
+} // namespace tracing
+
+void startTracing()
+{
+  g_StartTime = std::chrono::steady_clock::now();
+  getThreadBuffer(); // The calling thread is the first of the trace
+  tracing::g_Enabled = true;
+}
+
+void setTraceThreadName(std::string name)
+{
+  if (tracing::g_Enabled.load(std::memory_order_relaxed))
+  {
+    auto &buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock{g_RegistryMutex};
+    buffer.threadName = std::move(name);
+  }
+}
+
+bool writeTrace(const fs::path &path, std::string &err)
+{
+  // Complete events ("X") with microsecond timestamps, plus a metadata event
+  // naming each thread
+  auto events = nlohmann::json::array();
+  {
+    std::lock_guard<std::mutex> lock{g_RegistryMutex};
+    for (const auto &buffer : g_Registry)
+    {
+      events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", buffer->threadId},
+          {"args", {{"name", buffer->threadName}}}});
+
+      const auto count = std::min<uint64_t>(buffer->zoneCount, ZONES_PER_THREAD);
+      for (auto i = buffer->zoneCount - count; i < buffer->zoneCount; ++i)
+      {
+        const auto &zone = buffer->zones[i % ZONES_PER_THREAD];
+        events.push_back({{"name", zone.name}, {"ph", "X"}, {"pid", 1}, {"tid", buffer->threadId}, {"ts", zone.beginTime * 1e-3},
+            {"dur", (zone.endTime - zone.beginTime) * 1e-3}});
+      }
+    }
+  }
+
+  std::ofstream output{path.string()};
+  output << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump() << std::endl;
+  if (!output)
+  {
+    err = "unable to write " + path.string();
+    return false;
+  }
+  return true;
+}
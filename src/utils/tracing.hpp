@@ -0,0 +1,62 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// CPU tracing: TRACE_ZONE("name") records the begin and end of the enclosing
+// C++ scope in a ring buffer of the calling thread, and writeTrace() dumps the
+// zones of all threads in the Chrome Trace Event format (chrome://tracing,
+// Perfetto). Names must be string literals or otherwise outlive the trace.
+// While tracing is disabled a zone only costs a relaxed atomic load.
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__){name}
+
+namespace tracing {
+
+extern std::atomic<bool> g_Enabled;
+
+// Current time in nanoseconds since the start of tracing
+uint64_t now();
+
+void recordZone(const char *name, uint64_t beginTime, uint64_t endTime);
+
+} // namespace tracing
+
+// Start recording zones. Each thread keeps its most recent zones, older ones
+// are overwritten when its buffer is full.
+void startTracing();
+
+// Name the calling thread in the trace
+void setTraceThreadName(std::string name);
+
+// Write recorded zones as a Chrome trace. Threads must not record zones while
+// it runs. Return false and set err on IO error.
+bool writeTrace(const fs::path &path, std::string &err);
+
+class TraceZone
+{
+public:
+  explicit TraceZone(const char *name) :
+      m_Name(tracing::g_Enabled.load(std::memory_order_relaxed) ? name : nullptr), m_BeginTime(m_Name ? tracing::now() : 0)
+  {
+  }
+
+  ~TraceZone()
+  {
+    if (m_Name)
+    {
+      tracing::recordZone(m_Name, m_BeginTime, tracing::now());
+    }
+  }
+
+  TraceZone(const TraceZone &) = delete;
+  TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+  const char *m_Name;
+  uint64_t m_BeginTime;
+};
@@ -0,0 +1,98 @@
+// Round trip tests of ZlibStream, built as gltf-viewer-deflate-test: streams are
+// inflated with stb_image and must give back the written data.
+
+#include "utils/deflate.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_FailureCount = 0;
+
+// stb_image does not check the Adler-32 trailer of zlib streams
+uint32_t adler32(const std::vector<unsigned char> &data)
+{
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (const auto byte : data)
+  {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+// Compress data with writes of at most writeSize bytes, then inflate it
+void checkRoundTrip(const std::string &name, const std::vector<unsigned char> &data, int level, std::size_t writeSize)
+{
+  ZlibStream stream{level};
+  for (std::size_t offset = 0; offset < data.size(); offset += writeSize)
+  {
+    stream.write(data.data() + offset, std::min(writeSize, data.size() - offset));
+  }
+  stream.finish();
+  const auto &compressed = stream.output();
+
+  int size = 0;
+  auto *pInflated = stbi_zlib_decode_malloc(reinterpret_cast<const char *>(compressed.data()), int(compressed.size()), &size);
+  auto ok = pInflated && std::size_t(size) == data.size() && (data.empty() || std::memcmp(pInflated, data.data(), data.size()) == 0);
+
+  const auto *pTrailer = compressed.data() + compressed.size() - 4;
+  ok = ok && uint32_t((pTrailer[0] << 24) | (pTrailer[1] << 16) | (pTrailer[2] << 8) | pTrailer[3]) == adler32(data);
+
+  // Level 0 only writes stored blocks (BTYPE 00), after the 2 bytes header
+  if (level == 0 && !data.empty())
+  {
+    ok = ok && (compressed[2] & 0x6) == 0;
+  }
+
+  if (!ok)
+  {
+    std::cerr << "FAILED " << name << " level " << level << " (" << data.size() << " bytes, " << compressed.size() << " compressed)"
+              << std::endl;
+    ++g_FailureCount;
+  }
+  free(pInflated);
+}
+
+} // namespace
+
+int main()
+{
+  // Repetitive data with some noise, so that both matches and literals are
+  // produced
+  std::mt19937 random{42};
+  std::vector<unsigned char> large(200 * 1024);
+  for (std::size_t i = 0; i < large.size(); ++i)
+  {
+    large[i] = (random() % 8 == 0) ? (unsigned char)random() : (unsigned char)(i % 251);
+  }
+  const std::string text = "glTF viewer, glTF viewer, glTF viewer";
+  const std::vector<unsigned char> small(begin(text), end(text));
+
+  for (const auto level : {0, 1, 8, 9})
+  {
+    checkRoundTrip("empty", {}, level, 1);
+    checkRoundTrip("small", small, level, small.size());
+    checkRoundTrip("one byte writes", small, level, 1);
+    checkRoundTrip("larger than the window", large, level, large.size());
+    checkRoundTrip("several writes", large, level, 40000);
+  }
+
+  if (g_FailureCount)
+  {
+    std::cerr << g_FailureCount << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::clog << "All passed" << std::endl;
+  return EXIT_SUCCESS;
+}
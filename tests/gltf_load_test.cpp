@@ -0,0 +1,126 @@
+// Tests of loadGltfModel on invalid models, built as gltf-viewer-gltf_load-test:
+// models whose accessors, buffer views or indices reach out of their buffer
+// must fail to load with an error instead of being read out of bounds.
+
+#include "utils/filesystem.hpp"
+#include "utils/gltf.hpp"
+#include "utils/scene_generator.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_FailureCount = 0;
+
+// Write model as .glb, then load it
+bool writeAndLoad(const tinygltf::Model &model, const fs::path &path, std::string &err)
+{
+  auto writtenModel = model;
+  tinygltf::TinyGLTF writer;
+  if (!writer.WriteGltfSceneToFile(&writtenModel, path.string(), false, false, false, true))
+  {
+    err = "unable to write " + path.string();
+    return false;
+  }
+  tinygltf::Model loadedModel;
+  GltfBuffers buffers;
+  std::vector<EncodedImage> encodedImages;
+  std::string warn;
+  return loadGltfModel(path, loadedModel, buffers, encodedImages, err, warn);
+}
+
+// Load the generated model modified by modify, and check that it loads if
+// and only if it is expected to be valid
+void checkLoad(const std::string &name, const fs::path &directory, bool valid, const std::function<void(tinygltf::Model &)> &modify)
+{
+  SceneGeneratorOptions options;
+  options.nodeCount = 8;
+  options.depth = 2;
+  options.trianglesPerMesh = 32;
+  options.materialCount = 1;
+  options.textureCount = 0;
+  options.indexWidth = 16;
+  tinygltf::Model model;
+  std::string err;
+  if (!generateModel(options, model, err))
+  {
+    std::cerr << "FAILED " << name << ": " << err << std::endl;
+    ++g_FailureCount;
+    return;
+  }
+  modify(model);
+
+  err.clear();
+  const auto loaded = writeAndLoad(model, directory / (name + ".glb"), err);
+  if (loaded != valid || (!loaded && err.empty()))
+  {
+    std::cerr << "FAILED " << name << ": " << (loaded ? "loaded" : "not loaded") << " (" << err << ")" << std::endl;
+    ++g_FailureCount;
+  }
+}
+
+const tinygltf::Accessor &getPositionAccessor(const tinygltf::Model &model)
+{
+  return model.accessors[model.meshes[0].primitives[0].attributes.at("POSITION")];
+}
+
+} // namespace
+
+int main()
+{
+  const auto directory = fs::temp_directory_path() / "gltf-viewer-gltf-load-test";
+  fs::create_directories(directory);
+
+  checkLoad("valid", directory, true, [](tinygltf::Model &) {});
+
+  checkLoad("truncated accessor", directory, false, [](tinygltf::Model &model) {
+    auto &accessor = model.accessors[model.meshes[0].primitives[0].attributes.at("POSITION")];
+    accessor.count += 1;
+  });
+
+  checkLoad("accessor offset past its buffer view", directory, false, [](tinygltf::Model &model) {
+    auto &accessor = model.accessors[model.meshes[0].primitives[0].indices];
+    accessor.byteOffset = model.bufferViews[accessor.bufferView].byteLength;
+  });
+
+  checkLoad("buffer view past its buffer", directory, false, [](tinygltf::Model &model) {
+    auto &bufferView = model.bufferViews[getPositionAccessor(model).bufferView];
+    bufferView.byteOffset = model.buffers[0].data.size() - bufferView.byteLength + 4;
+  });
+
+  checkLoad("index past the vertices", directory, false, [](tinygltf::Model &model) {
+    const auto vertexCount = getPositionAccessor(model).count;
+    const auto &accessor = model.accessors[model.meshes[0].primitives[0].indices];
+    const auto &bufferView = model.bufferViews[accessor.bufferView];
+    const auto index = uint16_t(vertexCount);
+    std::memcpy(model.buffers[0].data.data() + bufferView.byteOffset + accessor.byteOffset, &index, sizeof(index));
+  });
+
+  checkLoad("invalid attribute accessor", directory, false, [](tinygltf::Model &model) {
+    model.meshes[0].primitives[0].attributes["NORMAL"] = int(model.accessors.size());
+  });
+
+  checkLoad("shared child node", directory, false, [](tinygltf::Model &model) {
+    const auto child = model.nodes[model.scenes[0].nodes[0]].children.at(0);
+    model.scenes[0].nodes.push_back(child);
+  });
+
+  std::error_code error;
+  fs::remove_all(directory, error);
+
+  if (g_FailureCount)
+  {
+    std::cerr << g_FailureCount << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::clog << "All passed" << std::endl;
+  return EXIT_SUCCESS;
+}
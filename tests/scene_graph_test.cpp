@@ -0,0 +1,173 @@
+// Tests of SceneGraph, built as gltf-viewer-scene_graph-test: world matrices
+// must match a recursive traversal of the glTF hierarchy, on construction and
+// after local transforms of nodes are changed.
+
+#include "utils/gltf.hpp"
+#include "utils/scene_generator.hpp"
+#include "utils/scene_graph.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_FailureCount = 0;
+
+void check(const std::string &name, bool ok)
+{
+  if (!ok)
+  {
+    std::cerr << "FAILED " << name << std::endl;
+    ++g_FailureCount;
+  }
+}
+
+bool nearlyEqual(const glm::mat4 &lhs, const glm::mat4 &rhs)
+{
+  for (int column = 0; column < 4; ++column)
+  {
+    for (int row = 0; row < 4; ++row)
+    {
+      if (std::abs(lhs[column][row] - rhs[column][row]) > 1e-4f * (1.f + std::abs(rhs[column][row])))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// World matrices of the nodes of the default scene, indexed like model.nodes
+std::vector<glm::mat4> computeWorldMatrices(const tinygltf::Model &model)
+{
+  std::vector<glm::mat4> worldMatrices(model.nodes.size());
+  const std::function<void(int, const glm::mat4 &)> visit = [&](int nodeIdx, const glm::mat4 &parentMatrix) {
+    const auto &node = model.nodes[nodeIdx];
+    worldMatrices[nodeIdx] = getLocalToWorldMatrix(node, parentMatrix);
+    for (const auto childIdx : node.children)
+    {
+      visit(childIdx, worldMatrices[nodeIdx]);
+    }
+  };
+  for (const auto nodeIdx : model.scenes[model.defaultScene].nodes)
+  {
+    visit(nodeIdx, glm::mat4(1));
+  }
+  return worldMatrices;
+}
+
+bool matchesModel(const SceneGraph &sceneGraph, const tinygltf::Model &model)
+{
+  const auto worldMatrices = computeWorldMatrices(model);
+  for (const auto &node : sceneGraph.nodes())
+  {
+    if (!nearlyEqual(node.worldMatrix, worldMatrices[node.gltfNode]))
+    {
+      return false;
+    }
+  }
+  return sceneGraph.nodes().size() == model.nodes.size();
+}
+
+// Each node is followed by its descendants, and by them only
+bool hasValidSubtrees(const SceneGraph &sceneGraph)
+{
+  const auto &nodes = sceneGraph.nodes();
+  for (int nodeIdx = 0; nodeIdx < int(nodes.size()); ++nodeIdx)
+  {
+    for (int otherIdx = nodeIdx + 1; otherIdx < int(nodes.size()); ++otherIdx)
+    {
+      auto ancestorIdx = nodes[otherIdx].parent;
+      while (ancestorIdx > nodeIdx)
+      {
+        ancestorIdx = nodes[ancestorIdx].parent;
+      }
+      if ((ancestorIdx == nodeIdx) != (otherIdx < nodes[nodeIdx].subtreeEnd))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  SceneGeneratorOptions options;
+  options.nodeCount = 40;
+  options.depth = 4;
+  options.trianglesPerMesh = 8;
+  options.materialCount = 0;
+  options.textureCount = 0;
+  tinygltf::Model model;
+  std::string err;
+  if (!generateModel(options, model, err))
+  {
+    std::cerr << "Error : " << err << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  SceneGraph sceneGraph{model, model.defaultScene};
+  check("construction", matchesModel(sceneGraph, model));
+  check("subtrees", hasValidSubtrees(sceneGraph));
+
+  // A node with children, which is not a root
+  auto nodeIdx = 0;
+  while (sceneGraph.nodes()[nodeIdx].parent < 0 || sceneGraph.nodes()[nodeIdx].subtreeEnd == nodeIdx + 1)
+  {
+    ++nodeIdx;
+  }
+  auto &gltfNode = model.nodes[sceneGraph.nodes()[nodeIdx].gltfNode];
+
+  const glm::vec3 translation{1.f, -2.f, 0.5f};
+  const auto rotation = glm::angleAxis(0.7f, glm::normalize(glm::vec3(1.f, 2.f, 3.f)));
+  const glm::vec3 scale{2.f, 0.5f, 1.5f};
+  sceneGraph.setTranslation(nodeIdx, translation);
+  sceneGraph.setRotation(nodeIdx, rotation);
+  sceneGraph.setScale(nodeIdx, scale);
+  check("world matrices are only updated on request", matchesModel(sceneGraph, model));
+  sceneGraph.updateWorldMatrices();
+  gltfNode.translation = {translation.x, translation.y, translation.z};
+  gltfNode.rotation = {rotation.x, rotation.y, rotation.z, rotation.w};
+  gltfNode.scale = {scale.x, scale.y, scale.z};
+  check("translation, rotation and scale", matchesModel(sceneGraph, model));
+
+  // Matrices are decomposed, including negative scales
+  const auto localMatrix =
+      glm::scale(glm::translate(glm::mat4(1), glm::vec3(3.f, 0.f, -1.f)) * glm::mat4_cast(rotation), glm::vec3(-1.f, 2.f, 3.f));
+  sceneGraph.setLocalMatrix(nodeIdx, localMatrix);
+  sceneGraph.updateWorldMatrices();
+  gltfNode.matrix.assign(&localMatrix[0][0], &localMatrix[0][0] + 16);
+  check("local matrix", matchesModel(sceneGraph, model));
+  sceneGraph.setScale(nodeIdx, sceneGraph.nodes()[nodeIdx].scale);
+  sceneGraph.updateWorldMatrices();
+  check("decomposed local matrix", matchesModel(sceneGraph, model));
+
+  // A root and one of its descendants changed together
+  sceneGraph.setTranslation(nodeIdx, glm::vec3(0.f));
+  sceneGraph.setTranslation(0, glm::vec3(5.f, 0.f, 0.f));
+  sceneGraph.updateWorldMatrices();
+  const auto &node = sceneGraph.nodes()[nodeIdx];
+  const auto newLocalMatrix = glm::scale(glm::mat4_cast(node.rotation), node.scale);
+  gltfNode.matrix.assign(&newLocalMatrix[0][0], &newLocalMatrix[0][0] + 16);
+  auto &gltfRoot = model.nodes[sceneGraph.nodes()[0].gltfNode];
+  gltfRoot.matrix.clear();
+  gltfRoot.translation = {5., 0., 0.};
+  check("nested changes", matchesModel(sceneGraph, model));
+
+  if (g_FailureCount)
+  {
+    std::cerr << g_FailureCount << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::clog << "All passed" << std::endl;
+  return EXIT_SUCCESS;
+}